@@ -0,0 +1,208 @@
+#include "commands/commands_registry.hpp"
+#include "config.hpp"
+#include "dispatch.hpp"
+#include "keyword_matcher.hpp"
+#include "main.hpp"
+#include "starboard.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Only the components being measured are built, no custom_cluster, so nothing here opens files or starts threads
+
+namespace {
+
+std::string randomWord(std::mt19937 &rng) {
+  std::uniform_int_distribution<int> length(2, 9);
+  std::uniform_int_distribution<int> letter('a', 'z');
+  std::string word(static_cast<size_t>(length(rng)), ' ');
+  for (char &c : word) {
+    c = static_cast<char>(letter(rng));
+  }
+  return word;
+}
+
+std::vector<std::string> keywordList(size_t count) {
+  std::mt19937 rng(1);
+  std::vector<std::string> keywords;
+  while (keywords.size() < count) {
+    // Mostly single words, some short phrases like "holy hell"
+    std::string keyword = randomWord(rng);
+    if (rng() % 4 == 0) keyword += " " + randomWord(rng);
+    keywords.push_back(keyword);
+  }
+  return keywords;
+}
+
+// Chat-like text of about `bytes` bytes, with a keyword every `hit_every` words on average
+std::string message(size_t bytes, const std::vector<std::string> &keywords, std::mt19937 &rng, unsigned hit_every = 40) {
+  std::string text;
+  while (text.size() < bytes) {
+    if (!text.empty()) text += rng() % 12 == 0 ? ". " : " ";
+    text += rng() % hit_every == 0 ? keywords[rng() % keywords.size()] : randomWord(rng);
+    if (rng() % 10 == 0) text[text.size() - 1] = static_cast<char>(std::toupper(text.back()));
+  }
+  text.resize(bytes);
+  return text;
+}
+
+// Messages are bucketed by size like Discord traffic: short replies, paragraphs, and walls of text
+std::vector<std::string> corpus(size_t bytes, const std::vector<std::string> &keywords) {
+  std::mt19937 rng(static_cast<unsigned>(bytes));
+  std::vector<std::string> messages;
+  for (int i = 0; i < 256; i++) {
+    messages.push_back(message(bytes, keywords, rng));
+  }
+  return messages;
+}
+
+json syntheticConfig(size_t keyword_count) {
+  json config = {{"token", "benchmark"},
+                 {"guildId", "100000000000000001"},
+                 {"botChannels", {"100000000000000002", "100000000000000003", "100000000000000004"}},
+                 {"specialChannel", "100000000000000005"},
+                 {"specialChannelEmote", "🔥"},
+                 {"starboardChannel", "100000000000000006"},
+                 {"keyWords", json::object()},
+                 {"keyWordsFiles", json::object()}};
+
+  // One in five keywords answers with a file, like the real config
+  const std::vector<std::string> keywords = keywordList(keyword_count);
+  for (size_t i = 0; i < keywords.size(); i++) {
+    if (i % 5 == 4) {
+      config["keyWordsFiles"][keywords[i]] = keywords[i] + ".png";
+    } else {
+      config["keyWords"][keywords[i]] = "response to " + keywords[i];
+    }
+  }
+  return config;
+}
+
+// Keyword matching as MessageCreateEvent does it: lowercase the content, then one matcher pass
+void BM_KeywordMatch(benchmark::State &state) {
+  const size_t keyword_count = static_cast<size_t>(state.range(0));
+  const size_t bytes = static_cast<size_t>(state.range(1));
+  const std::shared_ptr<const Config> config = Config::parse(syntheticConfig(keyword_count));
+  const std::vector<std::string> messages = corpus(bytes, keywordList(keyword_count));
+
+  size_t i = 0;
+  size_t hits = 0;
+  for (auto _ : state) {
+    std::string content = messages[i++ % messages.size()];
+    std::transform(content.begin(), content.end(), content.begin(), ::tolower);
+    const auto matches = config->matcher.match(content);
+    hits += matches.size();
+    benchmark::DoNotOptimize(matches.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+  state.counters["hits/msg"] = benchmark::Counter(static_cast<double>(hits) / static_cast<double>(state.iterations()));
+}
+BENCHMARK(BM_KeywordMatch)->ArgsProduct({{10, 100, 1000}, {32, 256, 2000}});
+
+// Building the matcher happens on every /keyword edit and /reload
+void BM_ConfigParse(benchmark::State &state) {
+  const json document = syntheticConfig(static_cast<size_t>(state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Config::parse(document));
+  }
+}
+BENCHMARK(BM_ConfigParse)->Arg(10)->Arg(100)->Arg(1000);
+
+// The filter every message create goes through on the gateway thread, half of them in a channel the bot ignores
+void BM_AcceptsMessage(benchmark::State &state) {
+  const std::shared_ptr<const Config> config = Config::parse(syntheticConfig(100));
+  const dpp::snowflake self = 300000000000000001;
+  std::vector<dpp::message> messages(4);
+  for (size_t i = 0; i < messages.size(); i++) {
+    messages[i].author.id = 200000000000000001;
+    messages[i].channel_id = i % 2 ? 100000000000000003 : 100000000000000099;
+  }
+
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(acceptsMessage(*config, self, messages[i++ % messages.size()]));
+  }
+}
+BENCHMARK(BM_AcceptsMessage);
+
+dpp::message starredMessage(size_t bytes, dpp::snowflake id) {
+  std::mt19937 rng(static_cast<unsigned>(bytes));
+  dpp::message msg;
+  msg.id = id;
+  msg.channel_id = 100000000000000002;
+  msg.author.id = 200000000000000001;
+  msg.author.username = "someone";
+  msg.content = message(bytes, keywordList(10), rng);
+  for (size_t i = 80; i < msg.content.size(); i += 80) {
+    msg.content[i] = '\n'; // Multi-line messages are quoted line by line
+  }
+  return msg;
+}
+
+// Embed built when a message crosses the threshold or is resynced, with and without a replied-to message
+void BM_StarboardEmbed(benchmark::State &state) {
+  const size_t bytes = static_cast<size_t>(state.range(0));
+  dpp::message msg = starredMessage(bytes, 1100000000000000000);
+  dpp::attachment image(&msg);
+  image.url = "https://cdn.discordapp.com/attachments/1/2/image.png";
+  image.content_type = "image/png";
+  msg.attachments.push_back(image);
+  const dpp::message ref = state.range(1) ? starredMessage(bytes, 1099999999999999999) : dpp::message();
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(buildStarboardEmbed(msg, ref));
+  }
+}
+BENCHMARK(BM_StarboardEmbed)->ArgsProduct({{32, 256, 2000}, {0, 1}});
+
+// Post text rewritten on every starboard edit
+void BM_StarboardContent(benchmark::State &state) {
+  const std::string url = "https://discord.com/channels/100000000000000001/100000000000000002/1100000000000000000";
+  int stars = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(starboardContent(stars++ % 50, "general", url));
+  }
+}
+BENCHMARK(BM_StarboardContent);
+
+// Handlers and series dispatchEvent queues for every gateway event
+template <typename EventType> void BM_EventRoutes(benchmark::State &state) {
+  for (auto _ : state) {
+    for (const HandlerRoute<EventType> &route : eventRoutes<EventType>()) {
+      benchmark::DoNotOptimize(&route.handler);
+    }
+  }
+}
+BENCHMARK(BM_EventRoutes<dpp::message_create_t>);
+BENCHMARK(BM_EventRoutes<dpp::message_reaction_add_t>);
+
+// Slash command routing on_slashcommand does, over the built-in commands, a quarter of the names miss
+void BM_RouteCommand(benchmark::State &state) {
+  const std::shared_ptr<const Config> config = Config::parse(syntheticConfig(100));
+  auto table = std::make_shared<custom_cluster::CommandTable>();
+  std::vector<std::string> names;
+  for (std::unique_ptr<Command> &command : CommandRegistry::instance().create_all_commands()) {
+    names.push_back(command->get_name());
+    (*table)[names.back()] = std::move(command);
+  }
+  std::mt19937 rng(3);
+  for (size_t i = 0, count = names.size() / 3; i < count; i++) {
+    names.push_back(randomWord(rng) + "_missing");
+  }
+  const dpp::snowflake channel = 100000000000000003;
+
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(routeCommand(*table, *config, names[i++ % names.size()], channel));
+  }
+}
+BENCHMARK(BM_RouteCommand);
+
+} // namespace
+
+BENCHMARK_MAIN();
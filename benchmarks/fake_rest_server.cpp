@@ -0,0 +1,428 @@
+#include "fake_rest_server.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+using boost::asio::ip::tcp;
+using Clock = std::chrono::steady_clock;
+using TlsStream = boost::asio::ssl::stream<tcp::socket>;
+
+constexpr uint64_t DISCORD_EPOCH_MS = 1420070400000;
+
+std::string lower(std::string value) {
+  std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return std::tolower(c); });
+  return value;
+}
+
+bool numeric(const std::string &segment) {
+  return !segment.empty() && std::all_of(segment.begin(), segment.end(), [](unsigned char c) { return std::isdigit(c); });
+}
+
+uint64_t toId(const std::string &segment) { return numeric(segment) ? std::stoull(segment) : 0; }
+
+std::string timestamp() {
+  const std::time_t now = std::time(nullptr);
+  char buffer[40];
+  std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S.000000+00:00", std::gmtime(&now));
+  return buffer;
+}
+
+// Path segments after /api/v<n>, without the query
+std::vector<std::string> splitPath(const std::string &target) {
+  const std::string path = target.substr(0, target.find('?'));
+  std::vector<std::string> segments;
+  size_t start = 0;
+  while (start <= path.size()) {
+    const size_t end = std::min(path.find('/', start), path.size());
+    if (end > start) segments.push_back(path.substr(start, end - start));
+    start = end + 1;
+  }
+  if (segments.size() >= 2 && segments[0] == "api" && segments[1].starts_with("v")) {
+    segments.erase(segments.begin(), segments.begin() + 2);
+  }
+  return segments;
+}
+
+// Rate limit key, ids are collapsed except the major parameter Discord buckets by
+std::string bucketKey(const std::string &method, const std::vector<std::string> &path) {
+  std::string key = method;
+  for (size_t i = 0; i < path.size(); i++) {
+    const bool major = i == 1 || (i == 2 && path[0] == "webhooks");
+    key += '/';
+    key += major                           ? path[i]
+           : i > 0 && path[i - 1] == "reactions" ? ":emoji"
+           : numeric(path[i])                   ? ":id"
+                                                : path[i];
+  }
+  return key;
+}
+
+// JSON sent as the payload_json part of a multipart upload, or the whole body otherwise
+json parseBody(const std::string &content_type, const std::string &body) {
+  std::string payload = body;
+  if (content_type.find("multipart/") != std::string::npos) {
+    const size_t part = body.find("name=\"payload_json\"");
+    const size_t start = part == std::string::npos ? part : body.find("\r\n\r\n", part);
+    if (start == std::string::npos) return json::object();
+    const size_t end = body.find("\r\n--", start + 4);
+    payload = body.substr(start + 4, end == std::string::npos ? std::string::npos : end - start - 4);
+  }
+  json parsed = json::parse(payload, nullptr, false);
+  return parsed.is_discarded() ? json::object() : parsed;
+}
+
+json botUser() {
+  return {{"id", std::to_string(FakeRestServer::BOT_ID)}, {"username", "replay-bot"}, {"discriminator", "0"},
+          {"avatar", nullptr}, {"bot", true}};
+}
+
+const char *reason(unsigned status) {
+  switch (status) {
+  case 200: return "OK";
+  case 204: return "No Content";
+  case 404: return "Not Found";
+  case 429: return "Too Many Requests";
+  default: return "Error";
+  }
+}
+
+// Self-signed certificate for discord.com, valid for a day
+std::pair<EVP_PKEY *, X509 *> makeCertificate() {
+  EVP_PKEY *key = EVP_EC_gen("P-256");
+  X509 *cert = X509_new();
+  if (!key || !cert) throw std::runtime_error("failed to generate a certificate");
+  X509_set_version(cert, 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 86400);
+  X509_set_pubkey(cert, key);
+
+  X509_NAME *name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char *>("discord.com"), -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+
+  X509V3_CTX ctx;
+  X509V3_set_ctx_nodb(&ctx);
+  X509V3_set_ctx(&ctx, cert, cert, nullptr, nullptr, 0);
+  for (const auto &[nid, value] : {std::pair{NID_subject_alt_name, "DNS:discord.com"}, std::pair{NID_basic_constraints, "critical,CA:TRUE"}}) {
+    X509_EXTENSION *extension = X509V3_EXT_conf_nid(nullptr, &ctx, nid, value);
+    X509_add_ext(cert, extension, -1);
+    X509_EXTENSION_free(extension);
+  }
+  X509_sign(cert, key, EVP_sha256());
+  return {key, cert};
+}
+
+// One TLS connection, requests are answered in order until the client closes it
+class Session : public std::enable_shared_from_this<Session> {
+public:
+  Session(FakeRestServer &server, tcp::socket socket, boost::asio::ssl::context &tls)
+      : server(server), stream(std::move(socket), tls) {}
+
+  void start() {
+    auto self = shared_from_this();
+    stream.async_handshake(boost::asio::ssl::stream_base::server, [self](const boost::system::error_code &ec) {
+      if (!ec) self->read_headers();
+    });
+  }
+
+private:
+  void read_headers() {
+    auto self = shared_from_this();
+    boost::asio::async_read_until(stream, boost::asio::dynamic_buffer(buffer, 1 << 20), "\r\n\r\n",
+                                  [self](const boost::system::error_code &ec, size_t header_length) {
+                                    if (!ec) self->parse(header_length);
+                                  });
+  }
+
+  void parse(size_t header_length) {
+    const std::string head = buffer.substr(0, header_length);
+    buffer.erase(0, header_length);
+
+    const size_t line_end = head.find("\r\n");
+    const std::string request_line = head.substr(0, line_end);
+    const size_t space = request_line.find(' ');
+    method = request_line.substr(0, space);
+    target = request_line.substr(space + 1, request_line.rfind(' ') - space - 1);
+
+    size_t content_length = 0;
+    content_type.clear();
+    keep_alive = true;
+    for (size_t start = line_end + 2; start < head.size();) {
+      const size_t end = head.find("\r\n", start);
+      const std::string line = head.substr(start, end - start);
+      start = end + 2;
+      const size_t colon = line.find(':');
+      if (colon == std::string::npos) continue;
+      const std::string name = lower(line.substr(0, colon));
+      const std::string value = line.substr(line.find_first_not_of(' ', colon + 1));
+      if (name == "content-length") content_length = std::stoul(value);
+      if (name == "content-type") content_type = value;
+      if (name == "connection" && lower(value) == "close") keep_alive = false;
+    }
+
+    if (buffer.size() >= content_length) {
+      respond(content_length);
+      return;
+    }
+    auto self = shared_from_this();
+    boost::asio::async_read(stream, boost::asio::dynamic_buffer(buffer),
+                            boost::asio::transfer_exactly(content_length - buffer.size()),
+                            [self, content_length](const boost::system::error_code &ec, size_t) {
+                              if (!ec) self->respond(content_length);
+                            });
+  }
+
+  void respond(size_t content_length) {
+    const std::string body = buffer.substr(0, content_length);
+    buffer.erase(0, content_length);
+
+    const FakeRestServer::Response answer = server.handle(method, target, content_type, body);
+    response = "HTTP/1.1 " + std::to_string(answer.status) + " " + reason(answer.status) + "\r\n";
+    for (const auto &[name, value] : answer.headers) {
+      response += name + ": " + value + "\r\n";
+    }
+    if (!answer.body.empty()) response += "Content-Type: application/json\r\n";
+    response += "Content-Length: " + std::to_string(answer.body.size()) + "\r\n";
+    response += keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    response += answer.body;
+
+    auto self = shared_from_this();
+    boost::asio::async_write(stream, boost::asio::buffer(response), [self](const boost::system::error_code &ec, size_t) {
+      if (ec) return;
+      if (self->keep_alive) {
+        self->read_headers();
+      } else {
+        self->stream.async_shutdown([self](const boost::system::error_code &) {});
+      }
+    });
+  }
+
+  FakeRestServer &server;
+  TlsStream stream;
+  std::string buffer;
+  std::string method;
+  std::string target;
+  std::string content_type;
+  std::string response;
+  bool keep_alive = true;
+};
+
+} // namespace
+
+FakeRestServer::FakeRestServer(Limits limits, unsigned threads) : limits(limits) {
+  const auto [key, cert] = makeCertificate();
+  SSL_CTX_use_certificate(tls.native_handle(), cert);
+  SSL_CTX_use_PrivateKey(tls.native_handle(), key);
+
+  // Written out so the bot's TLS client can be told to trust it
+  char path[] = "/tmp/fake-discord-XXXXXX.pem";
+  const int fd = mkstemps(path, 4);
+  std::FILE *file = fd >= 0 ? fdopen(fd, "w") : nullptr;
+  if (!file || PEM_write_X509(file, cert) != 1) throw std::runtime_error("failed to write the certificate");
+  std::fclose(file);
+  certificate_path = path;
+  X509_free(cert);
+  EVP_PKEY_free(key);
+
+  const tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), 0);
+  acceptor.open(endpoint.protocol());
+  acceptor.bind(endpoint);
+  acceptor.listen(boost::asio::socket_base::max_listen_connections);
+  accept();
+  for (unsigned i = 0; i < threads; i++) {
+    this->threads.emplace_back([this]() { io.run(); });
+  }
+  LOG_INFO("Fake REST server listening on 127.0.0.1:" << port());
+}
+
+FakeRestServer::~FakeRestServer() {
+  io.stop();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  unlink(certificate_path.c_str());
+}
+
+void FakeRestServer::accept() {
+  acceptor.async_accept([this](const boost::system::error_code &ec, tcp::socket socket) {
+    if (!ec) std::make_shared<Session>(*this, std::move(socket), tls)->start();
+    if (acceptor.is_open()) accept();
+  });
+}
+
+void FakeRestServer::put_message(const json &message) {
+  const uint64_t id = toId(message.value("id", std::string()));
+  if (id == 0) return;
+  std::lock_guard<std::mutex> lock(mutex);
+  messages[id] = message;
+}
+
+void FakeRestServer::react(uint64_t channel_id, uint64_t message_id, const std::string &emoji, int delta) {
+  std::lock_guard<std::mutex> lock(mutex);
+  json &message = messages.try_emplace(message_id, message_object(channel_id, message_id)).first->second;
+  json &reactions = message["reactions"];
+  if (!reactions.is_array()) reactions = json::array();
+
+  auto it = std::find_if(reactions.begin(), reactions.end(),
+                         [&emoji](const json &reaction) { return reaction["emoji"].value("name", "") == emoji; });
+  if (it == reactions.end()) {
+    if (delta <= 0) return;
+    reactions.push_back({{"count", 0}, {"me", false}, {"emoji", {{"id", nullptr}, {"name", emoji}}}});
+    it = reactions.end() - 1;
+  }
+  const int count = (*it)["count"].get<int>() + delta;
+  if (count <= 0) {
+    reactions.erase(it);
+  } else {
+    (*it)["count"] = count;
+  }
+}
+
+FakeRestServer::Stats FakeRestServer::stats() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return counts;
+}
+
+FakeRestServer::Response FakeRestServer::handle(const std::string &method, const std::string &target,
+                                                const std::string &content_type, const std::string &body) {
+  const std::vector<std::string> path = splitPath(target);
+  Response response{200, "", {}};
+
+  std::lock_guard<std::mutex> lock(mutex);
+  counts.requests++;
+  // Interaction callbacks aren't bound by Discord's rate limits
+  if (path.empty() || path[0] != "interactions") {
+    if (!take(global_bucket, limits.global, std::chrono::seconds(1), response)) {
+      response.headers.emplace_back("X-RateLimit-Global", "true");
+      response.headers.emplace_back("X-RateLimit-Scope", "global");
+      counts.rate_limited++;
+      return response;
+    }
+    response.headers.clear();
+    if (!take(buckets[bucketKey(method, path)], limits.per_route, limits.window, response)) {
+      response.headers.emplace_back("X-RateLimit-Scope", "user");
+      counts.rate_limited++;
+      return response;
+    }
+  }
+
+  Response answer = route(method, path, body.empty() ? json::object() : parseBody(content_type, body));
+  answer.headers.insert(answer.headers.end(), response.headers.begin(), response.headers.end());
+  return answer;
+}
+
+bool FakeRestServer::take(Bucket &bucket, unsigned limit, std::chrono::milliseconds window, Response &response) {
+  const Clock::time_point now = Clock::now();
+  if (now >= bucket.reset) {
+    bucket.reset = now + window;
+    bucket.used = 0;
+  }
+  const double reset_after = std::chrono::duration<double>(bucket.reset - now).count();
+  const bool allowed = bucket.used < limit;
+  if (allowed) bucket.used++;
+
+  char reset_text[32];
+  std::snprintf(reset_text, sizeof(reset_text), "%.3f", reset_after);
+  response.headers = {{"X-RateLimit-Limit", std::to_string(limit)},
+                      {"X-RateLimit-Remaining", std::to_string(limit - bucket.used)},
+                      {"X-RateLimit-Reset-After", reset_text},
+                      {"X-RateLimit-Reset", std::to_string(std::time(nullptr) + static_cast<long>(std::ceil(reset_after)))},
+                      {"X-RateLimit-Bucket", std::to_string(std::hash<const Bucket *>()(&bucket))}};
+  if (!allowed) {
+    response.status = 429;
+    response.headers.emplace_back("Retry-After", std::to_string(static_cast<long>(std::ceil(reset_after))));
+    response.body = json{{"message", "You are being rate limited."}, {"retry_after", reset_after}, {"global", false}}.dump();
+  }
+  return allowed;
+}
+
+FakeRestServer::Response FakeRestServer::route(const std::string &method, const std::vector<std::string> &path,
+                                               const json &request) {
+  const auto is = [&path](std::initializer_list<const char *> pattern) {
+    if (pattern.size() != path.size()) return false;
+    size_t i = 0;
+    for (const char *segment : pattern) {
+      if (segment[0] != '*' && path[i] != segment) return false;
+      i++;
+    }
+    return true;
+  };
+  const Response no_content{204, "", {}};
+
+  if (method == "DELETE" || (method == "PUT" && path.size() > 4 && path[4] == "reactions")) return no_content;
+  if (method == "POST" && (path.empty() || path.back() == "typing" || path.back() == "bulk-delete" || path[0] == "interactions")) {
+    return no_content;
+  }
+
+  // Messages in a channel, and the ones edited and sent through an interaction's webhook
+  if (method == "POST" && (is({"channels", "*", "messages"}) || is({"webhooks", "*", "*"}))) {
+    const uint64_t id = next_id();
+    json message = message_object(path[0] == "channels" ? toId(path[1]) : 0, id);
+    message["content"] = request.value("content", std::string());
+    message["embeds"] = request.value("embeds", json::array());
+    messages[id] = message;
+    return {200, message.dump(), {}};
+  }
+  if (is({"channels", "*", "messages", "*"}) || is({"webhooks", "*", "*", "messages", "*"})) {
+    const uint64_t channel_id = path[0] == "channels" ? toId(path[1]) : 0;
+    const uint64_t id = path[0] == "channels" ? toId(path[3]) : toId(path[4]);
+    json message = message_object(channel_id, id);
+    if (method == "PATCH") {
+      for (const char *field : {"content", "embeds", "flags"}) {
+        if (request.contains(field)) message[field] = request[field];
+      }
+      message["edited_timestamp"] = timestamp();
+      if (id != 0) messages[id] = message;
+    }
+    return {200, message.dump(), {}};
+  }
+  if (method == "GET" && is({"channels", "*"})) {
+    return {200, json{{"id", path[1]}, {"type", 0}, {"name", "channel-" + path[1]}}.dump(), {}};
+  }
+
+  // Guild command sync, nothing is registered remotely
+  if (is({"applications", "*", "guilds", "*", "commands"})) {
+    if (method == "GET") return {200, "[]", {}};
+    json command = request;
+    command["id"] = std::to_string(next_id());
+    command["application_id"] = path[1];
+    return {200, command.dump(), {}};
+  }
+
+  return {404, json{{"message", "404: Not Found"}, {"code", 0}}.dump(), {}};
+}
+
+json FakeRestServer::message_object(uint64_t channel_id, uint64_t message_id) {
+  if (auto it = messages.find(message_id); it != messages.end()) return it->second;
+  return {{"id", std::to_string(message_id)},
+          {"channel_id", std::to_string(channel_id)},
+          {"author", botUser()},
+          {"content", ""},
+          {"timestamp", timestamp()},
+          {"edited_timestamp", nullptr},
+          {"tts", false},
+          {"mention_everyone", false},
+          {"mentions", json::array()},
+          {"mention_roles", json::array()},
+          {"attachments", json::array()},
+          {"embeds", json::array()},
+          {"pinned", false},
+          {"type", 0}};
+}
+
+uint64_t FakeRestServer::next_id() {
+  const uint64_t ms = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+  return ((ms - DISCORD_EPOCH_MS) << 22) | (++sequence & 0x3fffff);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <utility> // Before asio, Boost 1.74 uses std::exchange without including it
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using json = nlohmann::json;
+
+// Stand-in for Discord's REST API on 127.0.0.1, served over TLS as discord.com with a self-signed certificate
+// Answers the endpoints the bot uses with plausible objects and rate limits each route like Discord does
+class FakeRestServer {
+public:
+  struct Limits {
+    unsigned per_route = 5; // Requests per window on one route, channel or guild
+    std::chrono::milliseconds window{5000};
+    unsigned global = 50; // Requests per second over all routes, interaction callbacks are exempt
+  };
+
+  struct Stats {
+    uint64_t requests;
+    uint64_t rate_limited; // Requests answered with 429
+  };
+
+  static constexpr uint64_t BOT_ID = 900000000000000001; // Author of messages the server creates
+
+  FakeRestServer(Limits limits, unsigned threads = 4);
+  ~FakeRestServer();
+
+  FakeRestServer(const FakeRestServer &) = delete;
+  FakeRestServer &operator=(const FakeRestServer &) = delete;
+
+  uint16_t port() const { return acceptor.local_endpoint().port(); }
+
+  // PEM file with the server's certificate, for clients to trust
+  const std::string &certificate_file() const { return certificate_path; }
+
+  // Keep Discord's side of replayed events, so fetched messages carry their content and reactions
+  void put_message(const json &message);
+  void react(uint64_t channel_id, uint64_t message_id, const std::string &emoji, int delta);
+
+  Stats stats();
+
+  struct Response {
+    unsigned status;
+    std::string body; // JSON, empty for 204
+    std::vector<std::pair<std::string, std::string>> headers;
+  };
+
+  // Answer one request, `target` is the path and query as sent
+  Response handle(const std::string &method, const std::string &target, const std::string &content_type,
+                  const std::string &body);
+
+private:
+  struct Bucket {
+    std::chrono::steady_clock::time_point reset;
+    unsigned used = 0;
+  };
+
+  Response route(const std::string &method, const std::vector<std::string> &path, const json &request);
+  bool take(Bucket &bucket, unsigned limit, std::chrono::milliseconds window, Response &response); // Caller holds mutex
+
+  json message_object(uint64_t channel_id, uint64_t message_id); // Caller holds mutex
+  uint64_t next_id();                                            // Caller holds mutex
+  void accept();
+
+  const Limits limits;
+  std::string certificate_path;
+
+  std::mutex mutex;
+  std::unordered_map<uint64_t, json> messages;
+  std::unordered_map<std::string, Bucket> buckets; // By method and route with its major parameter
+  Bucket global_bucket;
+  uint64_t sequence = 0;
+  Stats counts{0, 0};
+
+  boost::asio::io_context io;
+  boost::asio::ssl::context tls{boost::asio::ssl::context::tls_server};
+  boost::asio::ip::tcp::acceptor acceptor{io};
+  std::vector<std::thread> threads;
+};
@@ -0,0 +1,292 @@
+#include "commands/command.hpp"
+#include "commands/commands_registry.hpp"
+#include "dispatch.hpp"
+#include "fake_rest_server.hpp"
+#include "gateway_recorder.hpp"
+#include "main.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <iostream>
+#include <netdb.h>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Replays a capture written with "gatewayRecordFile" through the real handlers, against FakeRestServer
+// Run it from a scratch directory whose parent holds a copy of config.json, like build/ for the bot:
+// commands replayed from the capture edit that config, and starboard posts land in ../starboard.db
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::atomic<uint16_t> fakePort{0};
+
+// Commands that would run code on this machine or download attachments from Discord's CDN, left out of a replay
+const std::set<std::string> SKIPPED_COMMANDS = {"execute", "keywordfile"};
+
+struct Options {
+  std::string capture;
+  double speed = 1;  // Multiplier on the recorded pacing, 0 replays as fast as possible
+  unsigned repeat = 1;
+  std::chrono::seconds drain{30}; // How long to wait for handlers once the capture has been replayed
+  FakeRestServer::Limits limits;
+};
+
+void usage() {
+  std::cerr << "Usage: gateway_replay <capture> [--speed <factor>] [--repeat <n>] [--drain <seconds>]\n"
+               "                      [--route-limit <requests>] [--window-ms <ms>] [--global-limit <requests/s>]\n";
+}
+
+std::optional<Options> parseOptions(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    const std::string_view arg = argv[i];
+    if (!arg.starts_with("--")) {
+      options.capture = arg;
+      continue;
+    }
+    if (i + 1 >= argc) return std::nullopt;
+    const char *value = argv[++i];
+    if (arg == "--speed") {
+      options.speed = std::atof(value);
+    } else if (arg == "--repeat") {
+      options.repeat = static_cast<unsigned>(std::atoi(value));
+    } else if (arg == "--drain") {
+      options.drain = std::chrono::seconds(std::atoi(value));
+    } else if (arg == "--route-limit") {
+      options.limits.per_route = static_cast<unsigned>(std::atoi(value));
+    } else if (arg == "--window-ms") {
+      options.limits.window = std::chrono::milliseconds(std::atoi(value));
+    } else if (arg == "--global-limit") {
+      options.limits.global = static_cast<unsigned>(std::atoi(value));
+    } else {
+      return std::nullopt;
+    }
+  }
+  if (options.capture.empty()) return std::nullopt;
+  return options;
+}
+
+// Handler and command latencies as runEvent and runCommand record them
+struct Series {
+  std::string name;
+  Counter &started;
+  Histogram &latency;
+};
+
+template <typename EventType> void addRoutes(std::vector<Series> &series) {
+  for (const HandlerRoute<EventType> &route : eventRoutes<EventType>()) {
+    series.push_back({route.handler.get_name() + " (" + route.event_type + ")", route.runs, route.latency});
+  }
+}
+
+std::vector<Series> handlerSeries(custom_cluster &bot) {
+  // The series dispatch.cpp records into, commands with the same names and help texts
+  Metrics &metrics = Metrics::instance();
+  std::vector<Series> series;
+  addRoutes<dpp::message_create_t>(series);
+  addRoutes<dpp::message_reaction_add_t>(series);
+  addRoutes<dpp::message_reaction_remove_t>(series);
+  for (const auto &[name, command] : *bot.get_commands()) {
+    series.push_back({"/" + name, metrics.counter("bot_commands_total", "Slash commands run by name", {{"command", name}}),
+                      metrics.histogram("bot_command_seconds", "Slash command latency from dispatch to completion",
+                                        {{"command", name}})});
+  }
+  return series;
+}
+
+// Estimated from the bucket counts, interpolating inside the bucket the quantile falls into
+double quantile(const Histogram::Snapshot &snapshot, double q) {
+  const double rank = q * static_cast<double>(snapshot.count);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < snapshot.counts.size(); i++) {
+    if (snapshot.counts[i] > 0 && static_cast<double>(seen + snapshot.counts[i]) >= rank) {
+      if (i == Histogram::BOUNDS.size()) return INFINITY;
+      const double lower = i == 0 ? 0 : Histogram::BOUNDS[i - 1];
+      return lower + (Histogram::BOUNDS[i] - lower) * (rank - static_cast<double>(seen)) / static_cast<double>(snapshot.counts[i]);
+    }
+    seen += snapshot.counts[i];
+  }
+  return 0;
+}
+
+std::string milliseconds(double seconds) {
+  if (std::isinf(seconds)) return "> " + std::to_string(static_cast<int>(Histogram::BOUNDS.back() * 1000));
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.2f", seconds * 1000);
+  return text;
+}
+
+enum class Replayed { Dispatched, Skipped, Ignored };
+
+// Rebuild the event DPP would have dispatched and hand it to the bot's routers, keeping the fake server in step
+Replayed replay(custom_cluster &bot, FakeRestServer &server, const GatewayRecord &record) {
+  json frame = json::parse(record.raw, nullptr, false);
+  if (frame.is_discarded()) return Replayed::Ignored;
+  json &d = frame.contains("d") ? frame["d"] : frame;
+
+  switch (record.event) {
+  case GatewayEvent::MessageCreate: {
+    server.put_message(d);
+    dpp::message_create_t event(&bot, 0, record.raw);
+    event.msg = dpp::message(&bot).fill_from_json(&d);
+    bot.on_message_create.call(event);
+    return Replayed::Dispatched;
+  }
+  case GatewayEvent::ReactionAdd:
+  case GatewayEvent::ReactionRemove: {
+    const bool add = record.event == GatewayEvent::ReactionAdd;
+    const dpp::snowflake channel_id(d.value("channel_id", std::string("0")));
+    const dpp::snowflake message_id(d.value("message_id", std::string("0")));
+    const std::string emoji = d.contains("emoji") ? d["emoji"].value("name", std::string()) : std::string();
+    server.react(channel_id, message_id, emoji, add ? 1 : -1);
+
+    const auto fill = [&](auto &event) {
+      event.channel_id = channel_id;
+      event.message_id = message_id;
+      event.reacting_user.id = dpp::snowflake(d.value("user_id", std::string("0")));
+      if (d.contains("emoji")) event.reacting_emoji.fill_from_json(&d["emoji"]);
+    };
+    if (add) {
+      dpp::message_reaction_add_t event(&bot, 0, record.raw);
+      fill(event);
+      bot.on_message_reaction_add.call(event);
+    } else {
+      dpp::message_reaction_remove_t event(&bot, 0, record.raw);
+      fill(event);
+      bot.on_message_reaction_remove.call(event);
+    }
+    return Replayed::Dispatched;
+  }
+  case GatewayEvent::InteractionCreate: {
+    if (d.value("type", 0) != dpp::it_application_command) return Replayed::Ignored;
+    if (d.contains("data") && SKIPPED_COMMANDS.contains(d["data"].value("name", std::string()))) return Replayed::Skipped;
+    dpp::slashcommand_t event(&bot, 0, record.raw);
+    event.command.fill_from_json(&d);
+    bot.on_slashcommand.call(event);
+    return Replayed::Dispatched;
+  }
+  }
+  return Replayed::Ignored;
+}
+
+} // namespace
+
+// DPP resolves the hard-coded discord.com through getaddrinfo, this executable's definition takes precedence over
+// libc's for it (exported with ENABLE_EXPORTS), so REST requests reach the fake server
+// Any other host, like Discord's CDN, fails to resolve once the server is up, so nothing leaves the machine
+extern "C" int getaddrinfo(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res) {
+  using Resolve = int (*)(const char *, const char *, const struct addrinfo *, struct addrinfo **);
+  static const auto resolve = reinterpret_cast<Resolve>(dlsym(RTLD_NEXT, "getaddrinfo"));
+  const uint16_t port = fakePort.load();
+  if (port != 0 && node && std::strcmp(node, "discord.com") == 0) {
+    return resolve("127.0.0.1", std::to_string(port).c_str(), hints, res);
+  }
+  if (port != 0 && node && std::strcmp(node, "127.0.0.1") != 0 && std::strcmp(node, "localhost") != 0) {
+    return EAI_NONAME;
+  }
+  return resolve(node, service, hints, res);
+}
+
+int main(int argc, char **argv) {
+  const std::optional<Options> options = parseOptions(argc, argv);
+  if (!options) {
+    usage();
+    return 2;
+  }
+
+  FakeRestServer server(options->limits);
+  // DPP's TLS client trusts the fake server's certificate through OpenSSL's default verify paths
+  setenv("SSL_CERT_FILE", server.certificate_file().c_str(), 1);
+  fakePort = server.port();
+
+  custom_cluster bot("replay", dpp::intents::i_all_intents);
+  bot.load_config();
+  bot.me.id = FakeRestServer::BOT_ID;
+
+  // Built-in commands only, plugins aren't loaded
+  auto builtin = std::make_shared<custom_cluster::CommandTable>();
+  for (auto &command : CommandRegistry::instance().create_all_commands()) {
+    std::string name = command->get_name();
+    (*builtin)[name] = std::move(command);
+  }
+  bot.set_commands(std::move(builtin));
+  registerHandlers(bot);
+
+  const std::vector<Series> series = handlerSeries(bot);
+  const auto progress = [&series]() {
+    uint64_t started = 0;
+    uint64_t completed = 0;
+    for (const Series &s : series) {
+      started += s.started.value();
+      completed += s.latency.snapshot().count;
+    }
+    return std::pair{started, completed};
+  };
+
+  // Replay at the recorded pacing scaled by --speed
+  uint64_t events = 0;
+  uint64_t skipped = 0;
+  const Clock::time_point start = Clock::now();
+  Clock::time_point due = start;
+  for (unsigned pass = 0; pass < options->repeat; pass++) {
+    GatewayReader reader(options->capture);
+    if (!reader.is_open()) {
+      std::cerr << "Failed to open " << options->capture << "\n";
+      return 1;
+    }
+    while (std::optional<GatewayRecord> record = reader.next()) {
+      if (options->speed > 0) {
+        due += std::chrono::duration_cast<Clock::duration>(record->delay / options->speed);
+        std::this_thread::sleep_until(due);
+      }
+      const Replayed outcome = replay(bot, server, *record);
+      if (outcome == Replayed::Dispatched) events++;
+      if (outcome == Replayed::Skipped) skipped++;
+    }
+  }
+  const Clock::time_point replayed = Clock::now();
+
+  // Wait until every handler that started has finished and nothing is left queued
+  const Clock::time_point deadline = replayed + options->drain;
+  while (Clock::now() < deadline) {
+    const auto [started, completed] = progress();
+    if (started == completed && bot.executor.stats().queued == 0) break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  const Clock::time_point drained = Clock::now();
+  // Starboard edits run after the debounce, give them time to reach the server before counting requests
+  std::this_thread::sleep_for(bot.get_config()->starboard_debounce + std::chrono::seconds(1));
+
+  const double replay_seconds = std::chrono::duration<double>(replayed - start).count();
+  const double total_seconds = std::chrono::duration<double>(drained - start).count();
+  const auto [started, completed] = progress();
+  const FakeRestServer::Stats rest = server.stats();
+
+  std::printf("Replayed %llu events in %.2f s (%.0f events/s), skipped %llu /execute and /keywordfile commands\n",
+              static_cast<unsigned long long>(events), replay_seconds, static_cast<double>(events) / replay_seconds,
+              static_cast<unsigned long long>(skipped));
+  std::printf("Completed %llu of %llu handler runs in %.2f s (%.0f runs/s)\n", static_cast<unsigned long long>(completed),
+              static_cast<unsigned long long>(started), total_seconds, static_cast<double>(completed) / total_seconds);
+  std::printf("REST: %llu requests, %llu rate limited\n\n", static_cast<unsigned long long>(rest.requests),
+              static_cast<unsigned long long>(rest.rate_limited));
+
+  std::printf("%-36s %10s %10s %10s %10s %10s\n", "handler", "runs", "p50 ms", "p99 ms", "p99.9 ms", "mean ms");
+  for (const Series &s : series) {
+    const Histogram::Snapshot snapshot = s.latency.snapshot();
+    if (snapshot.count == 0) continue;
+    std::printf("%-36s %10llu %10s %10s %10s %10s\n", s.name.c_str(), static_cast<unsigned long long>(snapshot.count),
+                milliseconds(quantile(snapshot, 0.5)).c_str(), milliseconds(quantile(snapshot, 0.99)).c_str(),
+                milliseconds(quantile(snapshot, 0.999)).c_str(),
+                milliseconds(snapshot.sum / static_cast<double>(snapshot.count)).c_str());
+  }
+  return started == completed ? 0 : 1;
+}
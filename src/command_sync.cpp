@@ -0,0 +1,147 @@
+#include "command_sync.hpp"
+#include "commands/command.hpp"
+#include "hash.hpp"
+#include "logger.hpp"
+#include "timed_rest.hpp"
+#include <fstream>
+#include <map>
+
+namespace {
+
+// Hash of the definitions from the last successful sync, per guild
+const std::string CACHE_FILE = "../commands.hash";
+
+// Keep only the fields that describe a command, dropping ids, versions and unset defaults
+json normalize(const json &j) {
+  static const std::vector<std::string> fields = {
+      "name", "description", "type", "options", "choices", "value", "required", "min_value", "max_value",
+      "min_length", "max_length", "autocomplete", "channel_types", "default_member_permissions", "nsfw"};
+
+  if (j.is_array()) {
+    json out = json::array();
+    for (const auto &item : j) {
+      out.push_back(normalize(item));
+    }
+    return out;
+  }
+  if (!j.is_object()) return j;
+
+  json out = json::object();
+  for (const std::string &field : fields) {
+    auto it = j.find(field);
+    if (it == j.end() || it->is_null() || (it->is_boolean() && !it->get<bool>()) || (it->is_array() && it->empty())) {
+      continue;
+    }
+    out[field] = normalize(*it);
+  }
+  return out;
+}
+
+std::string fingerprint(const dpp::slashcommand &command) {
+  return normalize(json::parse(command.build_json(false))).dump();
+}
+
+std::string hashDefinitions(const std::map<std::string, std::string> &fingerprints) {
+  Fnv1a hash;
+  for (const auto &[name, print] : fingerprints) {
+    hash.add(name + '\0' + print + '\0');
+  }
+  return hash.hex();
+}
+
+std::string readCachedHash(dpp::snowflake guild_id) {
+  std::ifstream f(CACHE_FILE);
+  std::string guild;
+  std::string hash;
+  while (f >> guild >> hash) {
+    if (guild == guild_id.str()) return hash;
+  }
+  return "";
+}
+
+void writeCachedHash(dpp::snowflake guild_id, const std::string &hash) {
+  // Keep the hashes of other guilds
+  std::map<std::string, std::string> hashes;
+  {
+    std::ifstream f(CACHE_FILE);
+    std::string guild;
+    std::string old;
+    while (f >> guild >> old) {
+      hashes[guild] = old;
+    }
+  }
+  hashes[guild_id.str()] = hash;
+
+  std::ofstream f(CACHE_FILE, std::ofstream::out | std::ofstream::trunc);
+  for (const auto &[guild, h] : hashes) {
+    f << guild << " " << h << "\n";
+  }
+}
+
+} // namespace
+
+std::vector<dpp::slashcommand> slashCommandDefinitions(custom_cluster &bot) {
+  std::vector<dpp::slashcommand> scommands;
+  for (const auto &[name, command] : *bot.get_commands()) {
+    dpp::slashcommand scommand = dpp::slashcommand(command->get_name(), command->get_description(), bot.me.id);
+    for (const auto &option : command->get_options()) {
+      scommand.add_option(option);
+    }
+    scommand.set_default_permissions(command->get_permissions());
+    scommands.push_back(scommand);
+  }
+  return scommands;
+}
+
+dpp::task<void> syncSlashCommands(custom_cluster &bot, dpp::snowflake guild_id, std::vector<dpp::slashcommand> commands) {
+  std::map<std::string, std::string> fingerprints;
+  for (const auto &command : commands) {
+    fingerprints[command.name] = fingerprint(command);
+  }
+  const std::string hash = hashDefinitions(fingerprints);
+  if (hash == readCachedHash(guild_id)) {
+    LOG_DEBUG("Slash commands unchanged, skipping sync");
+    co_return;
+  }
+
+  LOG_DEBUG("Fetching registered slash commands");
+  const dpp::slashcommand_map remote = (co_await timedRest("guild_commands_get", bot.co_guild_commands_get(guild_id))).get<dpp::slashcommand_map>();
+  std::map<std::string, const dpp::slashcommand *> registered;
+  for (const auto &[id, command] : remote) {
+    registered[command.name] = &command;
+  }
+
+  bool failed = false;
+  auto check = [&failed](const dpp::confirmation_callback_t &result, const std::string &action) {
+    if (result.is_error()) {
+      LOG_ERROR("Failed to " << action << ": " << result.get_error().human_readable);
+      failed = true;
+    }
+  };
+
+  for (auto &command : commands) {
+    auto it = registered.find(command.name);
+    if (it == registered.end()) {
+      LOG_DEBUG("Creating slash command " + command.name);
+      check(co_await timedRest("guild_command_create", bot.co_guild_command_create(command, guild_id)), "create /" + command.name);
+      continue;
+    }
+    if (fingerprint(*it->second) != fingerprints[command.name]) {
+      LOG_DEBUG("Editing slash command " + command.name);
+      command.id = it->second->id;
+      check(co_await timedRest("guild_command_edit", bot.co_guild_command_edit(command, guild_id)), "edit /" + command.name);
+    }
+    registered.erase(it);
+  }
+
+  // Whatever is left is no longer defined locally
+  for (const auto &[name, command] : registered) {
+    LOG_DEBUG("Deleting slash command " + name);
+    check(co_await timedRest("guild_command_delete", bot.co_guild_command_delete(command->id, guild_id)), "delete /" + name);
+  }
+
+  // Only remember the hash once the guild really matches it, so a failed sync is retried
+  if (!failed) {
+    writeCachedHash(guild_id, hash);
+  }
+}
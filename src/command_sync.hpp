@@ -0,0 +1,11 @@
+#pragma once
+
+#include "main.hpp"
+#include <vector>
+
+// Slash command definitions for every command in the bot's command table
+std::vector<dpp::slashcommand> slashCommandDefinitions(custom_cluster &bot);
+
+// Bring the guild's slash commands in line with `commands`, creating, editing or deleting only what
+// changed. Skipped entirely when the definitions hash matches the last successful sync.
+dpp::task<void> syncSlashCommands(custom_cluster &bot, dpp::snowflake guild_id, std::vector<dpp::slashcommand> commands);
@@ -1,11 +1,24 @@
 #pragma once
 #include <dpp/dpp.h>
 #include "../main.hpp"
+#include <memory>
 #include <string>
 
-class Command {
+// Callbacks a command leaves behind, e.g. with bot.scheduler or bot.input, capture shared_from_this() if they can
+// run after co_execute returns: that keeps a plugin's code loaded until they are done
+class Command : public std::enable_shared_from_this<Command> {
 public:
-  virtual void execute(custom_cluster &bot, const dpp::slashcommand_t &event) = 0;
+  virtual ~Command() = default;
+
+  // Commands that don't wait on Discord override this
+  virtual void execute(custom_cluster &bot, const dpp::slashcommand_t &event) { (void)bot; (void)event; }
+
+  // Commands that await REST calls override this instead, so they don't park a thread per request
+  virtual dpp::task<void> co_execute(custom_cluster &bot, const dpp::slashcommand_t &event) {
+    execute(bot, event);
+    co_return;
+  }
+
   virtual std::string get_name() const = 0;
   virtual std::string get_description() const = 0;
   virtual std::vector<dpp::command_option> get_options() const = 0;
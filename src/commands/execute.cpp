@@ -1,118 +1,112 @@
 #include "command.hpp"
+#include "../compile_cache.hpp"
+#include "../process_runner.hpp"
+#include "../timed_rest.hpp"
 #include <dpp/dpp.h>
-#include <filesystem>
-#include <fstream>
-#include <random>
-#include <cstdlib>
-#include <future>
-#include <unordered_map>
+#include <functional>
 
 class ExecuteCommand : public Command {
 private:
   const dpp::snowflake ALLOWED_USER_ID = 539322589391093780;
-  // Map of user ID to pair of (channel ID, execution type)
-  static inline std::unordered_map<dpp::snowflake, std::pair<dpp::snowflake, std::string>> awaiting_code;
-  
-  std::string generate_random_filename() {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_int_distribution<> dis(0, 35);
-    static const char charset[] = "0123456789abcdefghijklmnopqrstuvwxyz";
-    
-    std::string filename = "temp_";
-    for(int i = 0; i < 10; i++) {
-      filename += charset[dis(gen)];
+  // Runs up to four commands at once, each on its own thread
+  ProcessRunner runner{4};
+
+  // Compiled snippets keyed by their source, so re-running the same code skips the compiler
+  CompileCache cache{[this](const std::string &cmd) { return runner.run(cmd, COMPILE_LIMITS); }};
+
+  // Timeout, kept output, CPU seconds, address space in KiB and processes. The process cap is shared with the bot's
+  // own threads, so it only stops runaway forking
+  static inline const ProcessRunner::Limits SHELL_LIMITS{std::chrono::seconds(60), 64 * 1024, 60, 1024 * 1024, 512};
+  static inline const ProcessRunner::Limits COMPILE_LIMITS{std::chrono::seconds(60), 64 * 1024, 60, 4 * 1024 * 1024, 512};
+  static inline const ProcessRunner::Limits PROGRAM_LIMITS{std::chrono::seconds(5), 64 * 1024, 5, 1024 * 1024, 512};
+
+  // Fit output into a single message, without cutting a UTF-8 sequence in half
+  static std::string format_output(std::string output, bool finished) {
+    constexpr size_t MAX_LENGTH = 1900;
+    if (output.size() > MAX_LENGTH) {
+      size_t cut = MAX_LENGTH;
+      while (cut > 0 && (static_cast<unsigned char>(output[cut]) & 0xC0) == 0x80) cut--;
+      output = output.substr(0, cut) + "\n... (truncated)";
     }
-    return filename;
+    return "```\n" + output + "\n```" + (finished ? "" : "\n*Running...*");
   }
 
-  std::string compile_and_run_cpp(const std::string& code) {
-    std::string filename = generate_random_filename();
-    std::string cpp_file = filename + ".cpp";
-    std::string exe_file = "./" + filename;
-    
-    // Write code to file
-    std::ofstream file(cpp_file);
-    file << code;
-    file.close();
-    
-    // Compile with a timeout and restricted permissions
-    std::string compile_cmd = "g++ -o " + filename + " " + cpp_file + " -std=c++20 2>&1";
-    std::string compile_output = execute_command(compile_cmd);
-    
-    if(std::filesystem::exists(filename)) {
-      // Run the compiled program with restrictions
-      std::string run_cmd = "timeout 5s " + exe_file + " 2>&1";
-      std::string output = execute_command(run_cmd);
-      
-      // Cleanup
-      std::filesystem::remove(cpp_file);
-      std::filesystem::remove(filename);
-      
-      return "Compilation successful.\nOutput:\n" + output;
-    } else {
-      std::filesystem::remove(cpp_file);
-      return "Compilation failed:\n" + compile_output;
+  static std::string describe(const ProcessRunner::Result &result) {
+    std::string status;
+    if (result.timed_out) {
+      status = "\n(killed after timeout)";
+    } else if (result.exit_code != 0) {
+      status = "\n(exit code " + std::to_string(result.exit_code) + ")";
     }
+    return result.output + (result.truncated ? "\n... (output limit reached)" : "") + status;
   }
-  
-  std::string execute_command(const std::string& cmd) {
-    std::array<char, 128> buffer;
-    std::string result;
-    std::unique_ptr<FILE, int(*)(FILE*)> pipe(popen(cmd.c_str(), "r"), pclose);
-    
-    if (!pipe) {
-      return "Failed to execute command.";
-    }
+
+  std::string compile_and_run_cpp(const std::string& code, const ProcessRunner::OutputCallback &on_output) {
+    const CompileCache::Result compiled = cache.compile(code);
+    const std::string stats = (compiled.hit ? "cache hit" : "compiled in " + std::to_string(compiled.time.count()) + " ms") +
+                              ", hit rate " + std::to_string(static_cast<int>(cache.hit_rate() * 100)) + "%";
     
-    while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-      result += buffer.data();
+    if(compiled.ok) {
+      // Run the compiled program with restrictions, streaming below the compile summary
+      const std::string header = "Compilation successful (" + stats + ").\nOutput:\n";
+      const ProcessRunner::Result result =
+          runner.run(compiled.binary, PROGRAM_LIMITS, [&](const std::string &output) { on_output(header + output); });
+      return header + describe(result);
+    } else {
+      return "Compilation failed (" + stats + "):\n" + describe(compiled.compiler);
     }
-    
-    return result;
+  }
+
+  // Run the code in the background, passing each progress update and the final output to `update`
+  void run_streaming(const std::string &type, const std::string &code, std::function<void(const std::string &)> update) {
+    runner.submit([this, type, code, update = std::move(update)]() {
+      const auto progress = [&update](const std::string &output) { update(format_output(output, false)); };
+      std::string output;
+      if(type == "shell") {
+        output = describe(runner.run(code, SHELL_LIMITS, progress));
+      } else if(type == "cpp") {
+        output = compile_and_run_cpp(code, progress);
+      }
+      update(format_output(output, true));
+    });
+  }
+
+  // Reply with a placeholder and stream the output into edits of it
+  dpp::job reply_streaming(custom_cluster& bot, const dpp::message_create_t msg_event, const std::string type, const std::string code) {
+    dpp::message reply = (co_await timedRest("message_create", msg_event.co_reply(dpp::message(format_output("", false))))).get<dpp::message>();
+    run_streaming(type, code, [&bot, reply](const std::string &content) mutable {
+      reply.set_content(content);
+      bot.message_edit(reply, timedCallback("message_edit"));
+    });
   }
 
 public:
-  void execute(custom_cluster& bot, const dpp::slashcommand_t& event) override {
+  // Jobs use the cache, which is destroyed before the runner
+  ~ExecuteCommand() override { runner.wait(); }
+
+  dpp::task<void> co_execute(custom_cluster& bot, const dpp::slashcommand_t& event) override {
     if(event.command.usr.id != ALLOWED_USER_ID) {
-      event.reply(dpp::message("You do not have permission to use this command.").set_flags(dpp::m_ephemeral));
-      return;
+      event.reply(dpp::message("You do not have permission to use this command.").set_flags(dpp::m_ephemeral), timedCallback("interaction_response"));
+      co_return;
     }
 
     auto options = event.command.get_command_interaction().options;
     std::string type = std::get<std::string>(options[0].value);
     
     if(options.size() > 1) {
-      // Direct input provided
+      // Direct input provided, reply first so the output can be streamed into edits of the response
       std::string input = std::get<std::string>(options[1].value);
-      
-      if(type == "shell") {
-        std::string output = execute_command(input);
-        event.reply(dpp::message("```\n" + output + "\n```"));
-      } else if(type == "cpp") {
-        std::string output = compile_and_run_cpp(input);
-        event.reply(dpp::message("```\n" + output + "\n```"));
-      }
+      co_await timedRest("interaction_response", event.co_reply(dpp::message(format_output("", false))));
+      run_streaming(type, input, [event](const std::string &content) {
+        event.edit_response(dpp::message(content), timedCallback("interaction_edit"));
+      });
     } else {
       // Wait for message with code block
-      awaiting_code[event.command.usr.id] = std::make_pair(event.command.channel_id, type);
-      event.reply(dpp::message("Please send your " + type + " code in a code block in this channel. You have 60 seconds.").set_flags(dpp::m_ephemeral));
-      
-      // Set a timer to remove the user from awaiting_code after 60 seconds
-      std::thread([user_id = event.command.usr.id]() {
-        std::this_thread::sleep_for(std::chrono::seconds(60));
-        awaiting_code.erase(user_id);
-      }).detach();
-      
-      bot.on_message_create([this, &bot](const dpp::message_create_t& msg_event) {
-        auto it = awaiting_code.find(msg_event.msg.author.id);
-        if(it == awaiting_code.end()) return;
-        
-        // Check if message is in the same channel as the command
-        if(msg_event.msg.channel_id != it->second.first) return;
-        
+      event.reply(dpp::message("Please send your " + type + " code in a code block in this channel. You have 60 seconds.").set_flags(dpp::m_ephemeral), timedCallback("interaction_response"));
+      bot.input.await(event.command.usr.id, event.command.channel_id, std::chrono::seconds(60),
+                      [this, &bot, type](const dpp::message_create_t &msg_event) {
         std::string content = msg_event.msg.content;
-        if(content.find("```") == std::string::npos) return;
+        if(content.find("```") == std::string::npos) return false;
         
         // Extract code from code block
         std::string code = content.substr(content.find("```") + 3);
@@ -125,18 +119,8 @@ public:
           code = code.substr(code.find("\n") + 1);
         }
         
-        std::string output;
-        std::string type = it->second.second;
-        if(type == "shell") {
-          output = execute_command(code);
-        } else if(type == "cpp") {
-          output = compile_and_run_cpp(code);
-        }
-        
-        // Remove user from awaiting list after processing
-        awaiting_code.erase(it);
-        
-        msg_event.reply(dpp::message("```\n" + output + "\n```"));
+        reply_streaming(bot, msg_event, type, code);
+        return true;
       });
     }
   }
@@ -1,21 +1,21 @@
 #include "../main.hpp"
 #include "command.hpp"
 #include "commands_registry.hpp"
+#include "../timed_rest.hpp"
 
 using json = nlohmann::json;
 
 class KeywordCommand : public Command {
 public:
   void execute(custom_cluster &bot, const dpp::slashcommand_t &event) override {
-    json config = bot.get_config(); 
     std::string keyword = std::get<std::string>(event.get_parameter("keyword"));
     std::string response = std::get<std::string>(event.get_parameter("response"));
 
-    config.at("keyWords")[keyword] = response;
-
-    event.reply("Keyword Added!");
-
-    bot.save_config(config);
+    if (bot.update_config(json::json_pointer("/keyWords") / keyword, response)) {
+      event.reply("Keyword Added!", timedCallback("interaction_response"));
+    } else {
+      event.reply("Keyword added, but saving it failed. It will be lost on restart unless a retry succeeds.", timedCallback("interaction_response"));
+    }
   }
 
   std::string get_name() const override { return "keyword"; }
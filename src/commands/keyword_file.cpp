@@ -1,31 +1,127 @@
 #include "../main.hpp"
 #include "command.hpp"
 #include "commands_registry.hpp"
+#include "../file_io.hpp"
+#include "../hash.hpp"
+#include "../timed_rest.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using json = nlohmann::json;
+namespace fs = std::filesystem;
+
+namespace {
+
+// Largest attachment accepted as a keyword response
+constexpr size_t MAX_FILE_BYTES = 25 * 1024 * 1024;
+
+const fs::path MEDIA_DIRECTORY = "../media";
+
+// Extension of an uploaded filename, keeping only characters safe in a path
+std::string safeExtension(const std::string &filename) {
+  std::string extension;
+  for (const char c : fs::path(filename).extension().string()) {
+    if (std::isalnum(static_cast<unsigned char>(c)) && extension.size() < 8) {
+      extension += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+  }
+  return extension.empty() ? "" : "." + extension;
+}
+
+// Uploaded filename reduced to characters safe in a path, replies attach the file under this name
+std::string safeName(const std::string &filename) {
+  std::string stem;
+  for (const char c : fs::path(filename).stem().string()) {
+    if (stem.size() == 48) break;
+    const bool safe = std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.';
+    stem += safe ? c : '_';
+  }
+  return (stem.empty() ? "file" : stem) + safeExtension(filename);
+}
+
+bool sameContent(const fs::path &path, const std::string &content) {
+  std::error_code ec;
+  if (fs::file_size(path, ec) != content.size() || ec) return false;
+  std::ifstream file(path, std::ios::binary);
+  return std::equal(content.begin(), content.end(), std::istreambuf_iterator<char>(file));
+}
+
+// Store the file under its content hash and uploaded name, returns the filename or empty on failure
+// See MediaCache::attachment_name for the naming scheme
+std::string storeMedia(const std::string &content, const std::string &uploadedName) {
+  const std::string hash = Fnv1a().add(content).hex();
+  const std::string uploaded = safeName(uploadedName);
+
+  // Identical uploads share one copy, a hash collision gets a numbered name instead
+  std::string name = hash + "-" + uploaded;
+  for (int i = 1; fs::exists(MEDIA_DIRECTORY / name); i++) {
+    if (sameContent(MEDIA_DIRECTORY / name, content)) return name;
+    name = hash + "_" + std::to_string(i) + "-" + uploaded;
+  }
+
+  // Write a temp file in the same directory and rename it, so the media cache never reads a partial file
+  std::string temp = (MEDIA_DIRECTORY / ".download-XXXXXX").string();
+  const int fd = mkstemp(temp.data());
+  if (fd < 0) return "";
+  fchmod(fd, 0644); // mkstemp creates files only the owner can read
+  const bool written = writeAll(fd, content) && fsync(fd) == 0;
+  close(fd);
+
+  std::error_code ec;
+  if (written) fs::rename(temp, MEDIA_DIRECTORY / name, ec);
+  if (!written || ec) {
+    fs::remove(temp, ec);
+    return "";
+  }
+  // The rename only survives a crash once the directory is synced
+  if (!syncParentDirectory((MEDIA_DIRECTORY / name).string())) return "";
+  return name;
+}
+
+} // namespace
 
 class KeywordFileCommand : public Command {
 public:
-  void execute(custom_cluster &bot, const dpp::slashcommand_t &event) override {
-    event.reply("Downloading file...");
-    json config = bot.get_config(); 
+  dpp::task<void> co_execute(custom_cluster &bot, const dpp::slashcommand_t &event) override {
     std::string keyword = std::get<std::string>(event.get_parameter("keyword"));
     dpp::snowflake file_id = std::get<dpp::snowflake>(event.get_parameter("response"));
 
     dpp::attachment response = event.command.resolved.attachments.at(file_id);
-
-    int ret = system(("curl -L '" + response.url + "' -o ../media/" + response.filename).c_str());
-
-    if (ret != 0) {
-      event.edit_response("Failed to download file! Return Code: " + std::to_string(ret));
-      return;
+    if (response.size > MAX_FILE_BYTES) {
+      event.reply("File is too large! The limit is " + std::to_string(MAX_FILE_BYTES / (1024 * 1024)) + " MiB.", timedCallback("interaction_response"));
+      co_return;
     }
+    event.reply("Downloading file...", timedCallback("interaction_response"));
 
-    config.at("keyWordsFiles")[keyword] = response.filename;
-
-    event.edit_response("Keyword added!");
+    // Download through the cluster's HTTP client instead of a curl process
+    dpp::http_request_completion_t download = co_await timedRest("attachment_download", bot.co_request(response.url, dpp::m_get));
+    if (download.error != dpp::h_success || download.status != 200) {
+      event.edit_response("Failed to download file! HTTP Status: " + std::to_string(download.status), timedCallback("interaction_edit"));
+      co_return;
+    }
+    if (download.body.size() > MAX_FILE_BYTES) {
+      event.edit_response("File is too large!", timedCallback("interaction_edit"));
+      co_return;
+    }
 
-    bot.save_config(config);
+    // Writing the file and journaling the config wait on fsync, keep that off DPP's threads
+    bot.executor.submit([self = shared_from_this(), &bot, event, keyword = std::move(keyword),
+                         content = std::move(download.body), uploadedName = response.filename]() {
+      const std::string filename = storeMedia(content, uploadedName);
+      if (filename.empty()) {
+        event.edit_response("Failed to save file!", timedCallback("interaction_edit"));
+      } else if (bot.update_config(json::json_pointer("/keyWordsFiles") / keyword, filename)) {
+        event.edit_response("Keyword added!", timedCallback("interaction_edit"));
+      } else {
+        event.edit_response("Keyword added, but saving it failed. It will be lost on restart unless a retry succeeds.", timedCallback("interaction_edit"));
+      }
+    });
   }
 
   std::string get_name() const override { return "keywordfile"; }
@@ -42,4 +138,3 @@ public:
 
 // Register the command using the macro
 REGISTER_COMMAND(KeywordFileCommand)
-
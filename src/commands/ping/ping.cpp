@@ -1,6 +1,6 @@
-#include "../main.hpp"
-#include "command.hpp"
-#include "commands_registry.hpp"
+#include "../command.hpp"
+#include "../../main.hpp"
+#include "../../timed_rest.hpp"
 
 class PingCommand : public Command {
 public:
@@ -15,7 +15,7 @@ public:
     const long latency = now - timestamp;
 
     // Reply with "Pong! Latency: <latency>ms"
-    event.reply("Pong! Latency: " + std::to_string(latency) + "ms");
+    event.reply("Pong! Latency: " + std::to_string(latency) + "ms", timedCallback("interaction_response"));
   }
 
   std::string get_name() const override { return "ping"; }
@@ -27,5 +27,7 @@ public:
   dpp::permission get_permissions() const override { return dpp::p_use_application_commands; }
 };
 
-// Register the command using the macro
-REGISTER_COMMAND(PingCommand)
+// Export, built as a plugin with add_command_plugin
+extern "C" {
+  Command *create_ping_command() { return new PingCommand(); }
+}
@@ -1,12 +1,13 @@
 #include "../main.hpp"
 #include "command.hpp"
 #include "commands_registry.hpp"
+#include "../timed_rest.hpp"
 
 class ReloadCommand : public Command {
 public:
   void execute(custom_cluster &bot, const dpp::slashcommand_t &event) override {
     bot.load_config();
-    event.reply("Config reloaded!");
+    event.reply("Config reloaded!", timedCallback("interaction_response"));
   }
 
   std::string get_name() const override { return "reload"; }
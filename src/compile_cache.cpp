@@ -0,0 +1,130 @@
+#include "compile_cache.hpp"
+#include "hash.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::string COMPILE_FLAGS = "-std=c++20";
+
+// Headers most snippets pull in, compiled once into the precompiled header
+const char *const PCH_HEADERS[] = {"algorithm", "array",  "chrono", "cmath",  "cstdint", "functional", "iostream",
+                                   "map",       "memory", "numeric", "random", "set",     "sstream",    "string",
+                                   "thread",    "tuple",  "unordered_map", "unordered_set", "utility", "vector"};
+
+} // namespace
+
+CompileCache::CompileCache(Runner run, std::string directory, size_t max_entries)
+    : run(std::move(run)), directory(std::move(directory)), max_entries(max_entries) {}
+
+bool CompileCache::pch() {
+  // Concurrent first compiles wait for the one building it
+  std::call_once(pch_once, [this]() {
+    compiler_version = run("g++ --version 2>&1").output;
+    pch_ready = build_pch();
+  });
+  return pch_ready;
+}
+
+bool CompileCache::build_pch() {
+  std::error_code ec;
+  fs::create_directories(fs::path(directory) / "pch", ec);
+  const fs::path header = fs::path(directory) / "pch" / "common.hpp";
+  const fs::path gch = fs::path(directory) / "pch" / "common.hpp.gch";
+
+  std::stringstream content;
+  for (const char *name : PCH_HEADERS) {
+    content << "#include <" << name << ">\n";
+  }
+
+  // Reuse the header from an earlier run if it hasn't changed
+  std::ifstream existing(header);
+  std::stringstream current;
+  current << existing.rdbuf();
+  if (current.str() == content.str() && fs::exists(gch, ec)) return true;
+
+  std::ofstream(header) << content.str();
+  run("g++ " + COMPILE_FLAGS + " -x c++-header " + header.string() + " -o " + gch.string() + " 2>&1");
+  return fs::exists(gch, ec);
+}
+
+CompileCache::Result CompileCache::compile(const std::string &code) {
+  const auto start = std::chrono::steady_clock::now();
+  const std::string flags = COMPILE_FLAGS + (pch() ? " -include " + (fs::path(directory) / "pch" / "common.hpp").string() : "");
+  const fs::path binary =
+      fs::path(directory) / Fnv1a().add(compiler_version).add(flags).add(std::string(1, '\0')).add(code).hex();
+  auto elapsed = [&start]() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  };
+
+  std::error_code ec;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fs::exists(binary, ec)) {
+      // Touch it so cleanup evicts least recently used binaries first
+      fs::last_write_time(binary, fs::file_time_type::clock::now(), ec);
+      hits++;
+      return {true, true, binary.string(), pin(binary.string()), {}, elapsed()};
+    }
+  }
+  misses++;
+
+  // Compile under a temporary name and rename, so concurrent requests never run a half-written binary
+  const std::string temp = binary.string() + ".tmp" + std::to_string(temp_counter++);
+  const std::string source = temp + ".cpp";
+  std::ofstream(source) << code;
+  ProcessRunner::Result compiler = run("g++ " + flags + " -o " + temp + " " + source + " 2>&1");
+  fs::remove(source, ec);
+
+  // A compiler killed by the timeout or a limit can leave a partial binary behind
+  if (compiler.exit_code != 0 || compiler.timed_out || !fs::exists(temp, ec)) {
+    fs::remove(temp, ec);
+    return {false, false, "", nullptr, std::move(compiler), elapsed()};
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  fs::rename(temp, binary, ec);
+  Pin held = pin(binary.string());
+  cleanup();
+  return {true, false, binary.string(), std::move(held), std::move(compiler), elapsed()};
+}
+
+double CompileCache::hit_rate() const {
+  const uint64_t total = hits + misses;
+  return total == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(total);
+}
+
+CompileCache::Pin CompileCache::pin(const std::string &binary) {
+  pinned[binary]++;
+  return Pin(new std::string(binary), [this](const std::string *path) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--pinned[*path] == 0) pinned.erase(*path);
+    }
+    delete path;
+  });
+}
+
+void CompileCache::cleanup() {
+  // Keep only the most recently used binaries, leaving alone those still about to run
+  std::vector<std::pair<fs::file_time_type, fs::path>> binaries;
+  std::error_code ec;
+  for (const auto &entry : fs::directory_iterator(directory, ec)) {
+    if (entry.is_regular_file(ec) && entry.path().extension().empty()) {
+      binaries.emplace_back(entry.last_write_time(ec), entry.path());
+    }
+  }
+  if (binaries.size() <= max_entries) return;
+
+  std::sort(binaries.begin(), binaries.end());
+  size_t excess = binaries.size() - max_entries;
+  for (size_t i = 0; i < binaries.size() && excess > 0; i++) {
+    if (pinned.contains(binaries[i].second.string())) continue;
+    fs::remove(binaries[i].second, ec);
+    excess--;
+  }
+}
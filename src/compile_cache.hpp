@@ -0,0 +1,60 @@
+#pragma once
+
+#include "process_runner.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Content-addressed cache of compiled /execute snippets, with a warm precompiled header for the std library
+class CompileCache {
+public:
+  // Runs a shell command under the compile limits
+  using Runner = std::function<ProcessRunner::Result(const std::string &)>;
+
+  // Keeps cleanup() from removing a binary while it is held, hold it until the binary has run
+  using Pin = std::shared_ptr<const std::string>;
+
+  struct Result {
+    bool ok;
+    bool hit;                        // Binary came from the cache, no compiler ran
+    std::string binary;              // Path of the executable when ok
+    Pin pin;                         // Held for `binary` when ok
+    ProcessRunner::Result compiler;  // The compiler run on a miss, with its output, exit code, timeout and truncation
+    std::chrono::milliseconds time;  // Time spent compiling or looking up
+  };
+
+  // Nothing is built or created on disk until the first compile()
+  explicit CompileCache(Runner run, std::string directory = "../cache/execute", size_t max_entries = 64);
+
+  CompileCache(const CompileCache &) = delete;
+  CompileCache &operator=(const CompileCache &) = delete;
+
+  Result compile(const std::string &code);
+
+  // Fraction of compile() calls served from the cache
+  double hit_rate() const;
+
+private:
+  bool pch(); // Builds the precompiled header on first use, true once it is usable
+  bool build_pch();
+  Pin pin(const std::string &binary); // Caller holds mutex
+  void cleanup();                     // Caller holds mutex
+
+  const Runner run;
+  const std::string directory;
+  const size_t max_entries;
+
+  std::once_flag pch_once;
+  bool pch_ready = false;
+  std::string compiler_version; // Part of every key, so upgrading the compiler doesn't reuse old binaries
+
+  std::mutex mutex;                                // Guards pinned, and the binaries against cleanup()
+  std::unordered_map<std::string, size_t> pinned;  // Pins held per binary path
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> misses{0};
+  std::atomic<uint64_t> temp_counter{0};
+};
@@ -0,0 +1,43 @@
+#include "config.hpp"
+#include <map>
+
+std::shared_ptr<const Config> Config::parse(json document) {
+  auto config = std::make_shared<Config>();
+
+  config->token = document.at("token").get<std::string>();
+  config->guild_id = document.at("guildId").get<dpp::snowflake>();
+  for (const dpp::snowflake channel : document.at("botChannels").get<std::vector<dpp::snowflake>>()) {
+    config->bot_channels.insert(channel);
+  }
+  config->special_channel = document.at("specialChannel").get<dpp::snowflake>();
+  config->special_channel_emote = document.at("specialChannelEmote").get<std::string>();
+  config->starboard_channel = document.at("starboardChannel").get<dpp::snowflake>();
+  config->starboard_debounce = std::chrono::milliseconds(document.value("starboardDebounceMs", 3000));
+  config->message_channels = config->bot_channels;
+  config->message_channels.insert(config->special_channel);
+
+  config->matcher = KeywordIndex(document.at("keyWords").get<std::map<std::string, std::string>>(),
+                                 document.at("keyWordsFiles").get<std::map<std::string, std::string>>());
+  config->media_cache_bytes = document.value("mediaCacheBytes", size_t{64} * 1024 * 1024);
+  config->log_level = parseLogLevel(document.value("logLevel", std::string("info")));
+  config->metrics_port = document.value("metricsPort", uint16_t{0});
+  config->gateway_record_file = document.value("gatewayRecordFile", std::string());
+  return config;
+}
+
+std::shared_ptr<const Config> Config::with(const json::json_pointer &pointer, const json &value) const {
+  if (pointer.empty() || !value.is_string()) return nullptr;
+  const std::string parent = pointer.parent_pointer().to_string();
+  KeywordIndex::Kind kind;
+  if (parent == "/keyWords") {
+    kind = KeywordIndex::Kind::Text;
+  } else if (parent == "/keyWordsFiles") {
+    kind = KeywordIndex::Kind::File;
+  } else {
+    return nullptr;
+  }
+
+  auto config = std::make_shared<Config>(*this);
+  config->matcher = matcher.with(pointer.back(), value.get<std::string>(), kind);
+  return config;
+}
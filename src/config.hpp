@@ -0,0 +1,36 @@
+#pragma once
+
+#include "keyword_matcher.hpp"
+#include "logger.hpp"
+#include <dpp/dpp.h>
+#include <chrono>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_set>
+
+using json = nlohmann::json;
+
+// Immutable, typed snapshot of config.json, parsed once per load and updated in place of a reparse for keyword edits
+struct Config {
+  std::string token;
+  dpp::snowflake guild_id;
+  std::unordered_set<dpp::snowflake> bot_channels;
+  dpp::snowflake special_channel;
+  std::string special_channel_emote;
+  dpp::snowflake starboard_channel;
+  std::chrono::milliseconds starboard_debounce; // Optional "starboardDebounceMs", 3 seconds by default
+  std::unordered_set<dpp::snowflake> message_channels; // Bot channels plus the special channel
+
+  KeywordIndex matcher; // "keyWords" and "keyWordsFiles"
+  size_t media_cache_bytes; // Optional "mediaCacheBytes", 64 MiB by default
+  LogLevel log_level;       // Optional "logLevel", info by default
+  uint16_t metrics_port;    // Optional "metricsPort" on 127.0.0.1, 0 (disabled) by default
+  std::string gateway_record_file; // Optional "gatewayRecordFile", read at startup, empty (disabled) by default
+
+  static std::shared_ptr<const Config> parse(json document);
+
+  // This snapshot with the value at `pointer` set, without reparsing the document. Only keyword edits are supported,
+  // nullptr for anything else
+  std::shared_ptr<const Config> with(const json::json_pointer &pointer, const json &value) const;
+};
@@ -0,0 +1,204 @@
+#include "config_store.hpp"
+#include "file_io.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Fold the journal into config.json right away once it holds this many edits, e.g. during a bulk import
+constexpr size_t COMPACT_ENTRIES = 1000;
+
+// Wait this long before writing again after a failed journal append
+constexpr std::chrono::seconds RETRY_DELAY{1};
+
+} // namespace
+
+ConfigStore::ConfigStore(std::string path, std::string journal_path, std::chrono::seconds compact_delay)
+    : path(std::move(path)), journal_path(std::move(journal_path)), compact_delay(compact_delay) {
+  fd = open(this->journal_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    LOG_ERROR("Failed to open " << this->journal_path << ", config edits won't be saved");
+  }
+  struct stat st;
+  if (fd >= 0 && fstat(fd, &st) == 0) journal_bytes = st.st_size;
+  thread = std::thread([this]() { run(); });
+}
+
+ConfigStore::~ConfigStore() {
+  close();
+  if (fd >= 0) ::close(fd);
+}
+
+void ConfigStore::close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  if (thread.joinable()) thread.join();
+}
+
+ConfigStore::json ConfigStore::load() {
+  // The writer touches the journal and config.json with the mutex released, wait for it to finish
+  std::unique_lock<std::mutex> lock(mutex);
+  idle.wait(lock, [this]() { return !writing; });
+
+  std::ifstream file(path);
+  json loaded = json::parse(file);
+
+  // Replay edits made since the last compaction, a torn last line is dropped
+  std::ifstream journal(journal_path);
+  std::string line;
+  off_t valid = 0;
+  size_t entries = 0;
+  while (std::getline(journal, line) && !journal.eof()) {
+    const json edit = json::parse(line, nullptr, false);
+    if (edit.is_discarded() || !edit.contains("path") || !edit.contains("value")) break;
+    loaded[json::json_pointer(edit["path"].get<std::string>())] = edit["value"];
+    valid += static_cast<off_t>(line.size() + 1);
+    entries++;
+  }
+  if (truncate(journal_path.c_str(), valid) != 0 && valid > 0) {
+    LOG_ERROR("Failed to truncate damaged tail of " << journal_path);
+  }
+
+  // Edits not written yet are part of the state too, they reach the journal with the next flush
+  std::istringstream queued(pending);
+  while (std::getline(queued, line)) {
+    const json edit = json::parse(line);
+    loaded[json::json_pointer(edit["path"].get<std::string>())] = edit["value"];
+  }
+
+  document = loaded;
+  journal_entries = entries;
+  journal_bytes = valid;
+  if (entries > 0) wake.notify_all(); // Let the writer fold them into config.json
+  return loaded;
+}
+
+uint64_t ConfigStore::append(const json::json_pointer &pointer, json value) {
+  const std::lock_guard<std::mutex> lock(mutex);
+  pending += json{{"path", pointer.to_string()}, {"value", value}}.dump() + "\n";
+  document[pointer] = std::move(value);
+  wake.notify_all();
+  return ++appended;
+}
+
+bool ConfigStore::wait(uint64_t sequence) {
+  // Edits arriving while a write is in progress share the next fsync
+  std::unique_lock<std::mutex> lock(mutex);
+  flushed.wait(lock, [this, sequence]() { return durable >= sequence || attempted >= sequence || stopped; });
+  return durable >= sequence;
+}
+
+ConfigStore::json ConfigStore::snapshot() {
+  const std::lock_guard<std::mutex> lock(mutex);
+  return document;
+}
+
+void ConfigStore::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    const auto now = std::chrono::steady_clock::now();
+    if (!pending.empty() && (now >= retry_at || stopping)) {
+      if (!flush(lock) && stopping) break; // One last attempt, the edits stay in memory only
+      continue;
+    }
+    const bool quiet = now - last_write >= compact_delay;
+    if (journal_entries > 0 && pending.empty() && (quiet || journal_entries >= COMPACT_ENTRIES || stopping)) {
+      compact(lock);
+      if (stopping && pending.empty()) break; // One last attempt, don't retry a failing compaction forever
+      continue;
+    }
+    if (stopping) break;
+
+    if (!pending.empty()) {
+      wake.wait_until(lock, retry_at);
+    } else if (journal_entries > 0) {
+      wake.wait_until(lock, last_write + compact_delay);
+    } else {
+      wake.wait(lock);
+    }
+  }
+  stopped = true; // Edits appended from now on are only in the in-memory document
+  flushed.notify_all();
+}
+
+bool ConfigStore::flush(std::unique_lock<std::mutex> &lock) {
+  const std::string lines = std::move(pending);
+  pending.clear();
+  const uint64_t sequence = appended;
+
+  writing = true;
+  lock.unlock();
+  bool ok = fd >= 0 && writeAll(fd, lines) && fdatasync(fd) == 0;
+  if (!ok) {
+    LOG_ERROR("Failed to append to " << journal_path << ", retrying");
+    // Cut off a partial line, it would hide every edit appended after it from the next load
+    if (fd >= 0 && ftruncate(fd, journal_bytes) != 0) {
+      LOG_ERROR("Failed to truncate " << journal_path << " back to its last edit");
+    }
+  }
+  lock.lock();
+  writing = false;
+  idle.notify_all();
+
+  attempted = sequence;
+  if (ok) {
+    durable = sequence;
+    journal_bytes += static_cast<off_t>(lines.size());
+    journal_entries += static_cast<size_t>(std::count(lines.begin(), lines.end(), '\n'));
+    last_write = std::chrono::steady_clock::now();
+  } else {
+    // Keep the edits queued ahead of newer ones, the waiters are told they aren't on disk yet
+    pending = lines + pending;
+    retry_at = std::chrono::steady_clock::now() + RETRY_DELAY;
+  }
+  flushed.notify_all();
+  return ok;
+}
+
+void ConfigStore::compact(std::unique_lock<std::mutex> &lock) {
+  // Only runs with nothing pending, so the journal holds no edit the snapshot is missing
+  const std::string snapshot = document.dump(2);
+  writing = true;
+  lock.unlock();
+
+  // Write the document next to the file and swap it in atomically, then start a fresh journal
+  const std::string tmp = path + ".tmp";
+  const int out = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  const bool ok = out >= 0 && writeAll(out, snapshot) && fsync(out) == 0;
+  if (out >= 0) ::close(out);
+  const bool renamed = ok && rename(tmp.c_str(), path.c_str()) == 0;
+  if (!renamed) {
+    LOG_ERROR("Failed to compact " << journal_path << " into " << path);
+    unlink(tmp.c_str());
+  }
+
+  // The journal may only go once the rename is durable, or a crash could pair the old file with an empty journal
+  const bool replaced = renamed && syncParentDirectory(path);
+  if (renamed && !replaced) {
+    LOG_ERROR("Failed to sync directory of " << path << ", keeping " << journal_path);
+  }
+
+  // The journal is only written with `writing` set, by this thread or by load() once it has waited this out
+  const bool truncated = replaced && fd >= 0 && ftruncate(fd, 0) == 0;
+  if (replaced && !truncated) {
+    LOG_ERROR("Failed to truncate " << journal_path);
+  }
+  lock.lock();
+  writing = false;
+  idle.notify_all();
+
+  if (truncated) {
+    journal_entries = 0;
+    journal_bytes = 0;
+  } else {
+    last_write = std::chrono::steady_clock::now(); // Retry after another delay rather than spinning
+  }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+
+// config.json plus an append-only journal of edits, folded back into the file in the background
+class ConfigStore {
+public:
+  using json = nlohmann::json;
+
+  explicit ConfigStore(std::string path = "../config.json", std::string journal_path = "../config.journal",
+                       std::chrono::seconds compact_delay = std::chrono::seconds(30));
+  ~ConfigStore();
+
+  ConfigStore(const ConfigStore &) = delete;
+  ConfigStore &operator=(const ConfigStore &) = delete;
+
+  // Read config.json and replay the journal over it
+  json load();
+
+  // Set the value at `pointer` and queue it for the journal, returns a sequence number to pass to wait()
+  uint64_t append(const json::json_pointer &pointer, json value);
+
+  // Returns once the edit append() numbered `sequence` is on disk, edits waited on together share one fdatasync
+  // False if writing it failed, it stays queued and is retried in the background
+  bool wait(uint64_t sequence);
+
+  // Copy of the current state, including edits not yet on disk
+  json snapshot();
+
+  // Write out pending edits, fold the journal into config.json and stop the writer thread
+  void close();
+
+private:
+  void run();
+  bool flush(std::unique_lock<std::mutex> &lock);   // Caller holds mutex, released while writing
+  void compact(std::unique_lock<std::mutex> &lock); // Caller holds mutex, released while writing
+
+  const std::string path;
+  const std::string journal_path;
+  const std::chrono::seconds compact_delay;
+
+  std::mutex mutex;
+  std::condition_variable wake;    // Writer thread, new edits or shutdown
+  std::condition_variable flushed; // Callers of wait(), their edit is durable or failed
+  std::condition_variable idle;    // Callers of load(), the writer is done with the files
+  json document;                   // Current state, what a compaction writes out
+  std::string pending;             // Journal lines not yet written
+  uint64_t appended = 0;           // Sequence number of the last edit
+  uint64_t durable = 0;            // Sequence number of the last edit on disk
+  uint64_t attempted = 0;          // Sequence number of the last edit a write was attempted for
+  size_t journal_entries = 0;      // Edits in the journal since the last compaction
+  off_t journal_bytes = 0;         // Length of the journal up to its last complete edit
+  bool writing = false;            // The writer is using the files with the mutex released
+  std::chrono::steady_clock::time_point last_write;
+  std::chrono::steady_clock::time_point retry_at; // After a failed append
+  bool stopping = false;
+  bool stopped = false; // Writer thread has exited
+  int fd = -1;
+  std::thread thread;
+};
@@ -0,0 +1,47 @@
+#include "directory_watcher.hpp"
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+DirectoryWatcher::DirectoryWatcher(const std::string &directory, uint32_t mask) {
+  inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  watching = inotify_fd >= 0 && pipe(stop_fds) == 0 && inotify_add_watch(inotify_fd, directory.c_str(), mask) >= 0;
+}
+
+DirectoryWatcher::~DirectoryWatcher() {
+  if (thread.joinable()) {
+    const char stop = 0;
+    (void)write(stop_fds[1], &stop, 1);
+    thread.join();
+  }
+  for (const int fd : {inotify_fd, stop_fds[0], stop_fds[1]}) {
+    if (fd >= 0) close(fd);
+  }
+}
+
+void DirectoryWatcher::start(Callback callback) {
+  if (!watching || thread.joinable()) return;
+  this->callback = std::move(callback);
+  thread = std::thread([this]() { run(); });
+}
+
+void DirectoryWatcher::run() {
+  alignas(inotify_event) char buffer[4096];
+  pollfd fds[2] = {{inotify_fd, POLLIN, 0}, {stop_fds[0], POLLIN, 0}};
+
+  while (true) {
+    if (poll(fds, 2, -1) < 0) continue;
+    if (fds[1].revents) return;
+
+    ssize_t length;
+    while ((length = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+      for (char *ptr = buffer; ptr < buffer + length;) {
+        const auto *event = reinterpret_cast<const inotify_event *>(ptr);
+        if (event->len > 0) {
+          callback(event->name, event->mask);
+        }
+        ptr += sizeof(inotify_event) + event->len;
+      }
+    }
+  }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+// Reports changes to the files directly in one directory through inotify, on a thread of its own
+class DirectoryWatcher {
+public:
+  // Filename relative to the directory and the inotify event mask
+  using Callback = std::function<void(const std::string &filename, uint32_t mask)>;
+
+  // Starts watching for the inotify events in `mask` right away, they are reported once start() is called
+  DirectoryWatcher(const std::string &directory, uint32_t mask);
+  ~DirectoryWatcher();
+
+  DirectoryWatcher(const DirectoryWatcher &) = delete;
+  DirectoryWatcher &operator=(const DirectoryWatcher &) = delete;
+
+  bool is_watching() const { return watching; }
+
+  // Call `callback` for every change from now on, until destruction
+  void start(Callback callback);
+
+private:
+  void run();
+
+  Callback callback;
+  bool watching = false;
+  int inotify_fd = -1;
+  int stop_fds[2] = {-1, -1};
+  std::thread thread;
+};
@@ -0,0 +1,185 @@
+#include "dispatch.hpp"
+#include "commands/command.hpp"
+#include "events/event.hpp"
+#include "events/events_registry.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "timed_rest.hpp"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Series a command records its runs into, resolved once instead of on every run
+struct RunMetrics {
+  Counter &runs;
+  Histogram &latency;
+};
+
+// Plugins can add commands at any time, so these are resolved on first use
+RunMetrics commandMetrics( const std::string &name ) {
+  return cachedSeries( name, [ &name ]() {
+    Metrics &metrics = Metrics::instance();
+    return RunMetrics{ metrics.counter( "bot_commands_total", "Slash commands run by name", { { "command", name } } ),
+                       metrics.histogram( "bot_command_seconds", "Slash command latency from dispatch to completion",
+                                          { { "command", name } } ) };
+  } );
+}
+
+// Label telling apart the event types one handler is registered for, e.g. reaction adds and removes
+template <typename EventType>
+constexpr const char *eventTypeName() {
+  if constexpr ( std::is_same_v<EventType, dpp::ready_t> ) {
+    return "ready";
+  } else if constexpr ( std::is_same_v<EventType, dpp::message_create_t> ) {
+    return "message_create";
+  } else if constexpr ( std::is_same_v<EventType, dpp::message_reaction_add_t> ) {
+    return "message_reaction_add";
+  } else {
+    static_assert( std::is_same_v<EventType, dpp::message_reaction_remove_t> );
+    return "message_reaction_remove";
+  }
+}
+
+// Run an event handler, the copied event lives in the coroutine frame until the handler is done
+// Latency is measured from dispatch, so time spent queued on the executor counts too
+template <typename EventType>
+dpp::job runEvent( custom_cluster &bot, const HandlerRoute<EventType> &route, const EventType event,
+                   Clock::time_point dispatched ) {
+  route.runs.add();
+  ScopedTimer timer( route.latency, dispatched );
+  try {
+    co_await route.handler.co_execute( bot, event );
+  } catch ( const std::exception &ex ) {
+    LOG_ERROR( route.handler.get_name() << " handler failed: " << ex.what() );
+  }
+}
+
+// Queue every handler registered for this event type, reactions on the same message stay in order
+template <typename EventType>
+void dispatchEvent( custom_cluster &bot, const EventType &event ) {
+  const Clock::time_point dispatched = Clock::now();
+  for ( const HandlerRoute<EventType> &route : eventRoutes<EventType>() ) {
+    if constexpr ( std::is_same_v<EventType, dpp::message_reaction_add_t> ||
+                   std::is_same_v<EventType, dpp::message_reaction_remove_t> ) {
+      bot.executor.submit( event.message_id,
+                           [ &bot, &route, event, dispatched ]() { runEvent( bot, route, event, dispatched ); } );
+    } else {
+      bot.executor.submit( [ &bot, &route, event, dispatched ]() { runEvent( bot, route, event, dispatched ); } );
+    }
+  }
+}
+
+// Run a slash command, the frame keeps both the event and the command's plugin alive until it is done
+dpp::job runCommand( custom_cluster &bot, const std::shared_ptr<Command> command, const dpp::slashcommand_t event,
+                     Clock::time_point dispatched ) {
+  const RunMetrics metrics = commandMetrics( command->get_name() );
+  metrics.runs.add();
+  ScopedTimer timer( metrics.latency, dispatched );
+  try {
+    co_await command->co_execute( bot, event );
+  } catch ( const std::exception &ex ) {
+    LOG_ERROR( "/" << command->get_name() << " failed: " << ex.what() );
+  }
+}
+
+} // namespace
+
+template <typename EventType>
+const std::vector<HandlerRoute<EventType>> &eventRoutes() {
+  // Handlers are registered during static initialization, so the table is complete by the first event
+  static const std::vector<HandlerRoute<EventType>> routes = []() {
+    Metrics &metrics = Metrics::instance();
+    std::vector<HandlerRoute<EventType>> resolved;
+    for ( const auto &handler : EventRegistry::instance().handlers<EventType>() ) {
+      const Metrics::Labels labels = { { "event", handler->get_name() }, { "event_type", eventTypeName<EventType>() } };
+      resolved.push_back( { *handler, eventTypeName<EventType>(),
+                            metrics.counter( "bot_events_total", "Events handled by handler", labels ),
+                            metrics.histogram( "bot_event_handler_seconds",
+                                               "Event latency from dispatch to handler completion", labels ) } );
+    }
+    return resolved;
+  }();
+  return routes;
+}
+
+template const std::vector<HandlerRoute<dpp::ready_t>> &eventRoutes<dpp::ready_t>();
+template const std::vector<HandlerRoute<dpp::message_create_t>> &eventRoutes<dpp::message_create_t>();
+template const std::vector<HandlerRoute<dpp::message_reaction_add_t>> &eventRoutes<dpp::message_reaction_add_t>();
+template const std::vector<HandlerRoute<dpp::message_reaction_remove_t>> &eventRoutes<dpp::message_reaction_remove_t>();
+
+bool acceptsMessage( const Config &config, dpp::snowflake self, const dpp::message &msg ) {
+  return msg.author.id != self && config.message_channels.contains( msg.channel_id );
+}
+
+CommandRoute routeCommand( const custom_cluster::CommandTable &commands, const Config &config, const std::string &name,
+                           dpp::snowflake channel_id ) {
+  auto it = commands.find( name );
+  if ( it == commands.end() ) {
+    return {};
+  }
+  return { it->second, config.bot_channels.contains( channel_id ) };
+}
+
+void registerHandlers( custom_cluster &bot, GatewayRecorder *recorder ) {
+  bot.on_ready( [ &bot ]( const dpp::ready_t &event ) { dispatchEvent( bot, event ); } );
+
+  bot.on_message_create( [ &bot, recorder ]( const dpp::message_create_t &event ) {
+    // The bot's own messages aren't recorded, a replay has no way to tell them apart
+    if ( recorder && event.msg.author.id != bot.me.id ) {
+      recorder->record( GatewayEvent::MessageCreate, event.raw_event );
+    }
+    // Drop messages the bot never acts on before they leave the gateway thread
+    if ( !acceptsMessage( *bot.get_config(), bot.me.id, event.msg ) ) {
+      return;
+    }
+    // Messages a command is waiting for are its input, not something to react to
+    if ( bot.input.route( event ) ) {
+      return;
+    }
+    dispatchEvent( bot, event );
+  } );
+
+  bot.on_message_reaction_add( [ &bot, recorder ]( const dpp::message_reaction_add_t &event ) {
+    if ( recorder ) {
+      recorder->record( GatewayEvent::ReactionAdd, event.raw_event );
+    }
+    dispatchEvent( bot, event );
+  } );
+
+  bot.on_message_reaction_remove( [ &bot, recorder ]( const dpp::message_reaction_remove_t &event ) {
+    if ( recorder ) {
+      recorder->record( GatewayEvent::ReactionRemove, event.raw_event );
+    }
+    dispatchEvent( bot, event );
+  } );
+
+  // Execute slash command if it's allowed in the channel
+  bot.on_slashcommand( [ &bot, recorder ]( const dpp::slashcommand_t &event ) {
+    if ( recorder ) {
+      recorder->record( GatewayEvent::InteractionCreate, event.raw_event );
+    }
+    CommandRoute route = routeCommand( *bot.get_commands(), *bot.get_config(), event.command.get_command_name(),
+                                       event.command.channel_id );
+    if ( !route.command ) {
+      return;
+    }
+    std::shared_ptr<Command> command = std::move( route.command );
+    LOG_DEBUG( "Executing slash command: " + command->get_name() );
+
+    if ( route.allowed ) {
+      // Execute the command if it's allowed
+      const Clock::time_point dispatched = Clock::now();
+      bot.executor.submit( [ &bot, event, command, dispatched ]() { runCommand( bot, command, event, dispatched ); } );
+    } else {
+      // Send an ephemeral message if it's not allowed
+      event.reply( dpp::message( "No." ).set_flags( dpp::m_ephemeral ), timedCallback( "interaction_response" ) );
+    }
+  } );
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "events/event.hpp"
+#include "gateway_recorder.hpp"
+#include "main.hpp"
+#include "metrics.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Route gateway events and slash commands to the registered handlers through bot.executor
+// Events are also appended to `recorder` when one is given
+void registerHandlers( custom_cluster &bot, GatewayRecorder *recorder = nullptr );
+
+// The lookups below are what the gateway thread does for every event before handing it to the executor
+
+// A handler registered for an event type, with the series its runs are recorded into
+template <typename EventType>
+struct HandlerRoute {
+  EventHandler<EventType> &handler;
+  const char *event_type; // Value of the event_type label, e.g. "message_reaction_add"
+  Counter &runs;
+  Histogram &latency;
+};
+
+// Handlers queued for every event of a type, instantiated for the event types registerHandlers listens to
+template <typename EventType>
+const std::vector<HandlerRoute<EventType>> &eventRoutes();
+
+// Whether a created message goes on to the handlers, the bot's own and those outside message_channels don't
+bool acceptsMessage( const Config &config, dpp::snowflake self, const dpp::message &msg );
+
+// The slash command `name` runs, null if there is none, and whether it may run in the channel
+struct CommandRoute {
+  std::shared_ptr<Command> command;
+  bool allowed = false;
+};
+CommandRoute routeCommand( const custom_cluster::CommandTable &commands, const Config &config, const std::string &name,
+                           dpp::snowflake channel_id );
@@ -1,17 +1,33 @@
 #pragma once
 #include <dpp/dpp.h>
 #include "../main.hpp"
+#include "../logger.hpp"
 #include <string>
 
-#ifdef VERBOSE_DEBUG
-#define LOG_DEBUG(msg) std::cout << "[DEBUG] " << msg << std::endl
-#else
-#define LOG_DEBUG(msg)
-#endif
-
-class Event {
+// Handler for one DPP event type
+template <typename EventType>
+class EventHandler {
 public:
-  virtual ~Event() = default;
+  virtual ~EventHandler() = default;
   virtual std::string get_name() const = 0;
-  virtual void execute(custom_cluster &bot, const dpp::event_dispatch_t &event) = 0;
-}; 
\ No newline at end of file
+
+  // Handlers that don't wait on Discord override this
+  virtual void execute(custom_cluster &bot, const EventType &event) { (void)bot; (void)event; }
+
+  // Handlers that await REST calls override this instead, so they don't park a thread per request
+  virtual dpp::task<void> co_execute(custom_cluster &bot, const EventType &event) {
+    execute(bot, event);
+    co_return;
+  }
+};
+
+// List of DPP event types an event class handles
+template <typename... EventTypes>
+struct EventTypeList {};
+
+// Base class for events, handles every DPP event type it is instantiated with
+template <typename... EventTypes>
+class Event : public EventHandler<EventTypes>... {
+public:
+  using event_types = EventTypeList<EventTypes...>;
+};
@@ -2,36 +2,42 @@
 
 #include "event.hpp"
 #include <memory>
-#include <string>
-#include <unordered_map>
 #include <vector>
 
-// Event registry to hold all events
+// Event registry holding one handler table per DPP event type
 class EventRegistry {
 public:
   static EventRegistry& instance() {
     static EventRegistry registry;
     return registry;
   }
-  
-  // Register an event factory function
-  void register_event(const std::string& name, std::unique_ptr<Event> (*creator)()) {
-    event_factories[name] = creator;
+
+  // Handlers for one event type, resolved at compile time without any lookup
+  template <typename EventType>
+  const std::vector<std::shared_ptr<EventHandler<EventType>>>& handlers() {
+    return table<EventType>();
   }
-  
-  // Create all registered events
-  std::vector<std::unique_ptr<Event>> create_all_events() {
-    std::vector<std::unique_ptr<Event>> events;
-    for (const auto& [name, factory] : event_factories) {
-      events.push_back(factory());
-    }
-    return events;
+
+  // Register an event under every event type it handles
+  template <typename EventClass>
+  void register_event() {
+    register_for(std::make_shared<EventClass>(), typename EventClass::event_types{});
   }
-  
+
 private:
   EventRegistry() = default;
-  std::unordered_map<std::string, std::unique_ptr<Event> (*)()> event_factories;
+
+  template <typename EventType>
+  static std::vector<std::shared_ptr<EventHandler<EventType>>>& table() {
+    static std::vector<std::shared_ptr<EventHandler<EventType>>> handlers;
+    return handlers;
+  }
+
+  template <typename EventClass, typename... EventTypes>
+  void register_for(const std::shared_ptr<EventClass>& event, EventTypeList<EventTypes...>) {
+    (table<EventTypes>().push_back(event), ...);
+  }
 };
 
 // Macro to register an event
-#define REGISTER_EVENT(EventClass) namespace { std::unique_ptr<Event> create_##EventClass() { return std::make_unique<EventClass>(); } struct EventClass##Registrar { EventClass##Registrar() { EventRegistry::instance().register_event(#EventClass, create_##EventClass); } }; EventClass##Registrar EventClass##_registrar; } 
\ No newline at end of file
+#define REGISTER_EVENT(EventClass) namespace { struct EventClass##Registrar { EventClass##Registrar() { EventRegistry::instance().register_event<EventClass>(); } }; EventClass##Registrar EventClass##_registrar; }
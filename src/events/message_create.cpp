@@ -1,59 +1,42 @@
 #include "event.hpp"
 #include "events_registry.hpp"
+#include "../timed_rest.hpp"
 #include <regex>
 #include <filesystem>
 #include <fstream>
-#include <thread>
-#include <chrono>
 
 namespace fs = std::filesystem;
 
 void logCallback(const dpp::confirmation_callback_t callback);
-void deleteAfterAsync(custom_cluster &bot, dpp::snowflake msgid, dpp::snowflake channelid, int seconds);
 
-class MessageCreateEvent : public Event {
+class MessageCreateEvent : public Event<dpp::message_create_t> {
 public:
-  void execute(custom_cluster &bot, const dpp::event_dispatch_t &event) override {
-    const auto &message_event = static_cast<const dpp::message_create_t &>(event);
-    
-    // Get the author, message, channel and config
-    const dpp::user author = message_event.msg.author;
-    const dpp::message msg = message_event.msg;
-    const dpp::channel channel = bot.channel_get_sync(message_event.msg.channel_id);
-    json config = bot.get_config();
-    const std::vector<dpp::snowflake> botChannels = config.at("botChannels");
-
-    // Ignore messages from the bot itself and from channels that are not bot channels
-    if (author.id == bot.me.id ||
-        std::find(botChannels.begin(), botChannels.end(), channel.id) == botChannels.end())
-      return;
-
-    // Get the content of the message
-    std::string content = message_event.msg.content;
-    std::transform(content.begin(), content.end(), content.begin(), ::tolower);
-
-    // Get the mentions, attachments and keywords
-    const std::vector<std::pair<dpp::user, dpp::guild_member>> mentions = message_event.msg.mentions;
-    const std::vector<dpp::attachment> attachments = message_event.msg.attachments;
-    const std::map<std::string, std::string> keywords = config.at("keyWords");
-    const std::map<std::string, std::string> keyWordsFiles = config.at("keyWordsFiles");
+  void execute(custom_cluster &bot, const dpp::message_create_t &message_event) override {
+    // Get the message, channel and config, the gateway handler already dropped our own messages
+    const dpp::message &msg = message_event.msg;
+    const dpp::snowflake channel_id = msg.channel_id;
+    const std::shared_ptr<const Config> config = bot.get_config();
 
     // React with an emoji to all attachments in the specified channel
-    if (channel.id == config.at("specialChannel").get<dpp::snowflake>() && !attachments.empty()) {
-      bot.message_add_reaction(msg, config.at("specialChannelEmote").get<std::string>(), logCallback);
+    if (channel_id == config->special_channel && !msg.attachments.empty()) {
+      bot.message_add_reaction(msg, config->special_channel_emote, timedCallback("message_add_reaction", logCallback));
     }
 
-    // Check for custom keywords and reply with the corresponding response
-    for (const auto &keyword : keywords) {
-      if (content.find(keyword.first) != std::string::npos) {
-        message_event.reply(dpp::message(keyword.second), true, logCallback);
-      }
-    }
+    // Ignore messages from channels that are not bot channels
+    if (!config->bot_channels.contains(channel_id))
+      return;
+
+    // Get the content of the message
+    std::string content = msg.content;
+    std::transform(content.begin(), content.end(), content.begin(), ::tolower);
 
-    // Check for custom keywords with file responses and reply with the corresponding file
-    for (const auto &keyWordFile : keyWordsFiles) {
-      if (content.find(keyWordFile.first) != std::string::npos) {
-        handleFileResponse(bot, message_event, keyWordFile.second);
+    // Reply to every keyword found in the message, text responses first and file responses after
+    for (const KeywordMatcher::Keyword *keyword : config->matcher.match(content)) {
+      keywordHits(*keyword).add();
+      if (keyword->kind == KeywordMatcher::Kind::Text) {
+        bot.outbound.send(replyTo(msg, dpp::message(keyword->response)), logCallback);
+      } else {
+        handleFileResponse(bot, message_event, keyword->response);
       }
     }
 
@@ -66,26 +49,37 @@ public:
   std::string get_name() const override { return "message_create"; }
 
 private:
-  void handleFileResponse(custom_cluster &bot, const dpp::message_create_t &event, const std::string &filename) {
-    std::ifstream f("../media/" + filename);
-    if (f) {
-      // typing indicator coroutine
-      bot.channel_typing(bot.channel_get_sync(event.msg.channel_id));
+  // Hit counter for `keyword`
+  static Counter &keywordHits(const KeywordMatcher::Keyword &keyword) {
+    const auto resolve = [&keyword](const char *kind) {
+      return &Metrics::instance().counter("bot_keyword_hits_total", "Messages that matched a keyword",
+                                          {{"keyword", keyword.keyword}, {"kind", kind}});
+    };
+    if (keyword.kind == KeywordMatcher::Kind::Text) {
+      return *cachedSeries(keyword.keyword, [&resolve]() { return resolve("text"); });
+    }
+    return *cachedSeries(keyword.keyword, [&resolve]() { return resolve("file"); });
+  }
 
-      // Read the file size
-      f.seekg(0, std::ios::end);
-      std::streamsize length = f.tellg();
-      f.seekg(0, std::ios::beg);
+  // Reply to `msg`, pinging its author like message_create_t::reply(message, true)
+  static dpp::message replyTo(const dpp::message &msg, dpp::message reply) {
+    reply.set_reference(msg.id, msg.guild_id).set_channel_id(msg.channel_id);
+    reply.allowed_mentions.replied_user = true;
+    return reply;
+  }
 
-      // Read the file content
-      std::vector<char> buffer(length);
-      if (f.read(buffer.data(), length)) {
-        std::string fileContent(buffer.begin(), buffer.end());
+  void handleFileResponse(custom_cluster &bot, const dpp::message_create_t &event, const std::string &filename) {
+    // Shared with the cache
+    const std::shared_ptr<const std::string> fileContent = bot.media.get(filename);
+    if (fileContent) {
+      // typing indicator coroutine
+      bot.channel_typing(event.msg.channel_id, timedCallback("channel_typing"));
 
-        // Reply with the file
-        event.reply(dpp::message().add_file(filename, fileContent), true, logCallback);
-        f.close();
-      }
+      // add_file copies the file into the message, DPP has no way to borrow the cached buffer
+      // The message is then moved into the outbound queue, not copied again
+      dpp::message reply =
+          replyTo(event.msg, dpp::message().add_file(MediaCache::attachment_name(filename), *fileContent));
+      bot.outbound.send(std::move(reply), logCallback);
     }
   }
 
@@ -104,16 +98,9 @@ private:
                                    "Jessica is not fucking welcome here!",
                                    "Holy bishops on skateboards"};
 
-    // Reply with a random sentence
-    dpp::message msg_ = dpp::message().set_reference(event.msg.id).set_channel_id(event.msg.channel_id);
-    msg_.allowed_mentions.replied_user = true;
-
-    // Reply with a random sentence and set the reference to the sent message
-    for (const auto &sentence : arr) {
-      msg_.set_reference(bot.message_create_sync(msg_.set_content(sentence)).id);
-      // Sleep for 1 second (rate limit)
-      std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-    }
+    // Reply to the message, then chain each sentence as a reply to the previous one as fast as the rate limit allows
+    dpp::message msg_ = replyTo(event.msg, dpp::message());
+    bot.outbound.send_chain(msg_, std::move(arr));
   }
 };
 
@@ -2,13 +2,18 @@
 #include "events_registry.hpp"
 #include "../starboard.hpp"
 
-class ReactionEvent : public Event {
+class ReactionEvent : public Event<dpp::message_reaction_add_t, dpp::message_reaction_remove_t> {
 public:
-  void execute(custom_cluster &bot, const dpp::event_dispatch_t &event) override {
-    if (const auto *add_event = dynamic_cast<const dpp::message_reaction_add_t *>(&event)) {
-      updateStarboardMessage(bot, *add_event);
-    } else if (const auto *remove_event = dynamic_cast<const dpp::message_reaction_remove_t *>(&event)) {
-      updateStarboardMessage(bot, *remove_event);
+  // Only stars matter to the starboard, other emoji never reach it
+  void execute(custom_cluster &bot, const dpp::message_reaction_add_t &event) override {
+    if (event.reacting_emoji.name == "⭐") {
+      updateStarboardMessage(bot, event);
+    }
+  }
+
+  void execute(custom_cluster &bot, const dpp::message_reaction_remove_t &event) override {
+    if (event.reacting_emoji.name == "⭐") {
+      updateStarboardMessage(bot, event);
     }
   }
 
@@ -16,4 +21,4 @@ public:
 };
 
 // Register the event
-REGISTER_EVENT(ReactionEvent) 
\ No newline at end of file
+REGISTER_EVENT(ReactionEvent) 
@@ -1,43 +1,19 @@
 #include "event.hpp"
 #include "events_registry.hpp"
-#include "../commands/command.hpp"
-#include "../commands/commands_registry.hpp"
+#include "../command_sync.hpp"
 
-class ReadyEvent : public Event {
+class ReadyEvent : public Event<dpp::ready_t> {
 public:
-  void execute(custom_cluster &bot, const dpp::event_dispatch_t &event) override {
-    const auto &ready_event = static_cast<const dpp::ready_t &>(event);
+  dpp::task<void> co_execute(custom_cluster &bot, const dpp::ready_t &ready_event) override {
     (void)ready_event; // Suppress unused variable warning
     LOG_DEBUG("Bot ready event triggered");
 
     // Get the guild ID
-    dpp::snowflake guild_id = bot.get_config().at("guildId").get<dpp::snowflake>();
-    LOG_DEBUG("Deleting all commands in the guild");
-    
-    // Delete all commands in the guild
-    bot.guild_bulk_command_delete_sync(guild_id);
+    dpp::snowflake guild_id = bot.get_config()->guild_id;
 
-    // Get commands from the command registry
-    std::vector<std::unique_ptr<Command>> commands = CommandRegistry::instance().create_all_commands();
-
-    // Create a vector of slash commands from the commands vector
-    std::vector<dpp::slashcommand> scommands;
-    for (const auto &command : commands) {
-      dpp::slashcommand scommand = dpp::slashcommand(command->get_name(), command->get_description(), bot.me.id);
-      for (const auto &option : command->get_options()) {
-        scommand.add_option(option);
-      }
-      scommand.set_default_permissions(command->get_permissions());
-      scommands.push_back(scommand);
-    }
-
-    // Rate limit the command creation
-    LOG_DEBUG("Waiting for 10 seconds before creating commands");
-    std::this_thread::sleep_for(std::chrono::seconds(10));
-
-    LOG_DEBUG("Creating all slash commands in the guild");
-    // Create all slash commands in the guild
-    bot.guild_bulk_command_create_sync(scommands, guild_id);
+    LOG_DEBUG("Syncing slash commands in the guild");
+    // Only touch the commands that changed, the rest stay usable throughout
+    co_await syncSlashCommands(bot, guild_id, slashCommandDefinitions(bot));
 
     // Set the bot's status
     dpp::activity activity;
@@ -0,0 +1,158 @@
+#include "executor.hpp"
+#include "logger.hpp"
+
+namespace {
+// Index of the worker running on the current thread, or -1 outside the pool
+thread_local long current_worker = -1;
+thread_local const Executor *current_executor = nullptr;
+} // namespace
+
+Executor::Executor(size_t thread_count) {
+  thread_count = std::max<size_t>(1, thread_count);
+  for (size_t i = 0; i < thread_count; i++) {
+    workers.push_back(std::make_unique<Worker>());
+  }
+  for (size_t i = 0; i < thread_count; i++) {
+    threads.emplace_back([this, i]() { run(i); });
+  }
+}
+
+Executor::~Executor() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex);
+    stopping = true;
+  }
+  for (auto &worker : workers) {
+    worker->wake.notify_one();
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+void Executor::submit(Task task) {
+  // Tasks queued from inside the pool stay on the submitting worker for locality
+  size_t index = current_executor == this ? static_cast<size_t>(current_worker)
+                                          : next.fetch_add(1, std::memory_order_relaxed) % workers.size();
+  // Count before publishing so a worker popping it never drives the counter below zero
+  stealable.fetch_add(1);
+  {
+    std::lock_guard<std::mutex> lock(workers[index]->mutex);
+    workers[index]->tasks.push_back(std::move(task));
+  }
+  notify(nullptr);
+}
+
+void Executor::submit(uint64_t key, Task task) {
+  Worker &worker = *workers[key % workers.size()];
+  worker.ordered_count.fetch_add(1);
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.ordered.push_back(std::move(task));
+  }
+  // Only the owning worker can run this task, so wake it rather than a random sleeper
+  notify(&worker);
+}
+
+Executor::Stats Executor::stats() const {
+  size_t queued = stealable.load();
+  for (const auto &worker : workers) {
+    queued += worker->ordered_count.load();
+  }
+  return {queued, executed.load(), stolen.load()};
+}
+
+void Executor::notify(Worker *owner) {
+  // Under the lock, a worker either saw the counter update before it went to sleep or is marked asleep by now
+  std::lock_guard<std::mutex> lock(sleep_mutex);
+  if (!owner) {
+    for (auto &worker : workers) {
+      if (worker->asleep) {
+        owner = worker.get();
+        break;
+      }
+    }
+  }
+  if (owner && owner->asleep) {
+    owner->asleep = false;
+    owner->wake.notify_one();
+  }
+}
+
+bool Executor::pop(size_t index, Task &task) {
+  Worker &worker = *workers[index];
+  std::lock_guard<std::mutex> lock(worker.mutex);
+  if (!worker.ordered.empty()) {
+    task = std::move(worker.ordered.front());
+    worker.ordered.pop_front();
+    worker.ordered_count.fetch_sub(1);
+    return true;
+  }
+  if (!worker.tasks.empty()) {
+    task = std::move(worker.tasks.front());
+    worker.tasks.pop_front();
+    stealable.fetch_sub(1);
+    return true;
+  }
+  return false;
+}
+
+bool Executor::steal(size_t thief, Task &task) {
+  // Take from the back of a victim's queue so its owner keeps the oldest work
+  // Busy victims are skipped on the first pass and waited for on the second, so a contended lock never looks
+  // like an empty pool while stealable work is counted, which would keep the thief from sleeping
+  bool contended = false;
+  for (int pass = 0; pass < 2 && (pass == 0 || contended); pass++) {
+    for (size_t offset = 1; offset < workers.size(); offset++) {
+      Worker &victim = *workers[(thief + offset) % workers.size()];
+      std::unique_lock<std::mutex> lock(victim.mutex, std::defer_lock);
+      if (pass == 0 && !lock.try_lock()) {
+        contended = true;
+        continue;
+      }
+      if (pass == 1) lock.lock();
+      if (victim.tasks.empty()) continue;
+      task = std::move(victim.tasks.back());
+      victim.tasks.pop_back();
+      stealable.fetch_sub(1);
+      stolen.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void Executor::run(size_t index) {
+  current_worker = static_cast<long>(index);
+  current_executor = this;
+  Worker &self = *workers[index];
+
+  while (true) {
+    Task task;
+    if (pop(index, task) || steal(index, task)) {
+      try {
+        task();
+      } catch (const std::exception &e) {
+        LOG_ERROR("Unhandled exception in executor task: " << e.what());
+      }
+      executed.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+
+    // stealable is counted just before the task is published, so it can briefly be non-zero with every queue
+    // empty, yield instead of spinning through the predicate until the submitter catches up
+    std::unique_lock<std::mutex> lock(sleep_mutex);
+    if (!stopping && stealable.load() > 0 && self.ordered_count.load() == 0) {
+      lock.unlock();
+      std::this_thread::yield();
+      continue;
+    }
+    // Cleared on wakeup, so a worker still waiting is always marked and notify() never picks one that is awake
+    while (!stopping && stealable.load() == 0 && self.ordered_count.load() == 0) {
+      self.asleep = true;
+      self.wake.wait(lock);
+      self.asleep = false;
+    }
+    if (stopping) return;
+  }
+}
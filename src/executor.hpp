@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size work-stealing thread pool used to dispatch events and commands
+class Executor {
+public:
+  using Task = std::function<void()>;
+
+  struct Stats {
+    size_t queued;     // Tasks waiting in all worker queues
+    uint64_t executed; // Tasks run since startup
+    uint64_t stolen;   // Tasks run by a worker other than the one they were queued on
+  };
+
+  explicit Executor(size_t thread_count = std::max(2u, std::thread::hardware_concurrency()));
+  ~Executor();
+
+  Executor(const Executor &) = delete;
+  Executor &operator=(const Executor &) = delete;
+
+  // Queue a task on any worker
+  void submit(Task task);
+
+  // Queue a task on the worker owning `key`, tasks sharing a key start in submission order
+  // Only the synchronous part is ordered: a coroutine started by the task, like runEvent's dpp::job, resumes on DPP's
+  // threads after its first co_await, so later tasks for the key can overtake it from there on
+  void submit(uint64_t key, Task task);
+
+  Stats stats() const;
+  size_t size() const { return workers.size(); }
+
+private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;   // May be stolen by other workers
+    std::deque<Task> ordered; // Keyed tasks, only ever run by this worker
+    std::atomic<size_t> ordered_count{0};
+    std::condition_variable wake; // Waited on with sleep_mutex
+    bool asleep = false;          // Guarded by sleep_mutex, cleared by whoever wakes it
+  };
+
+  void run(size_t index);
+  bool pop(size_t index, Task &task);
+  bool steal(size_t thief, Task &task);
+  void notify(Worker *owner); // Wake `owner`, or any sleeping worker if null
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<std::thread> threads;
+
+  std::mutex sleep_mutex;
+  bool stopping = false;
+
+  std::atomic<size_t> stealable{0};
+  std::atomic<size_t> next{0};
+  std::atomic<uint64_t> executed{0};
+  std::atomic<uint64_t> stolen{0};
+};
@@ -0,0 +1,26 @@
+#include "file_io.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+bool writeAll(int fd, const void *data, size_t length) {
+  const auto *ptr = static_cast<const char *>(data);
+  while (length > 0) {
+    const ssize_t written = write(fd, ptr, length);
+    if (written < 0 && errno == EINTR) continue;
+    if (written < 0) return false;
+    ptr += written;
+    length -= static_cast<size_t>(written);
+  }
+  return true;
+}
+
+bool syncParentDirectory(const std::string &path) {
+  const size_t slash = path.rfind('/');
+  const std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+  const int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) return false;
+  const bool ok = fsync(fd) == 0;
+  close(fd);
+  return ok;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Write all of `data` to `fd`, continuing after short writes and EINTR
+bool writeAll(int fd, const void *data, size_t length);
+inline bool writeAll(int fd, const std::string &data) { return writeAll(fd, data.data(), data.size()); }
+
+// Sync the directory holding `path`, so a file created or renamed there survives a crash
+bool syncParentDirectory(const std::string &path);
@@ -0,0 +1,137 @@
+#include "gateway_recorder.hpp"
+#include "logger.hpp"
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+
+constexpr char MAGIC[] = "BDGW1\n"; // Format version, bumped if the record layout changes
+constexpr size_t FLUSH_BYTES = 64 * 1024;
+// Larger than any gateway payload the bot records, a length beyond it means the file is damaged
+constexpr uint64_t MAX_RECORD_BYTES = 16 * 1024 * 1024;
+
+void putVarint(std::string &out, uint64_t value) {
+  while (value >= 0x80) {
+    out += static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+std::optional<uint64_t> getVarint(std::FILE *file) {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    const int c = std::fgetc(file);
+    if (c == EOF) return std::nullopt;
+    value |= static_cast<uint64_t>(c & 0x7f) << shift;
+    if ((c & 0x80) == 0) return value;
+  }
+  return std::nullopt;
+}
+
+} // namespace
+
+GatewayRecorder::GatewayRecorder(const std::string &path) {
+  // Append to an earlier capture, cutting off a record torn by a crash so new records start on a boundary
+  std::error_code ec;
+  const uintmax_t size = std::filesystem::file_size(path, ec);
+  const bool existing = !ec && size > 0;
+  if (existing) {
+    GatewayReader reader(path);
+    if (!reader.is_open()) {
+      LOG_ERROR("Not recording to " << path << ", it holds something other than a gateway capture");
+      return;
+    }
+    while (reader.next()) {
+    }
+    if (reader.valid_bytes() < size) {
+      std::filesystem::resize_file(path, reader.valid_bytes(), ec);
+      if (ec) {
+        LOG_ERROR("Not recording to " << path << ", failed to truncate its damaged tail: " << ec.message());
+        return;
+      }
+    }
+  }
+
+  file = std::fopen(path.c_str(), "ab");
+  if (!file) {
+    LOG_ERROR("Failed to open " << path << " for recording: " << std::strerror(errno));
+    return;
+  }
+  if (!existing) buffer = std::string(MAGIC, sizeof(MAGIC) - 1);
+  LOG_INFO("Recording gateway events to " << path);
+}
+
+GatewayRecorder::~GatewayRecorder() {
+  if (!file) return;
+  flush();
+  std::fclose(file);
+}
+
+void GatewayRecorder::record(GatewayEvent event, const std::string &raw) {
+  if (!file) return;
+  const auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(mutex);
+  putVarint(buffer, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - last).count()));
+  buffer += static_cast<char>(event);
+  putVarint(buffer, raw.size());
+  buffer += raw;
+  last = now;
+  if (buffer.size() >= FLUSH_BYTES) {
+    write_buffer();
+  }
+}
+
+void GatewayRecorder::flush() {
+  if (!file) return;
+  std::lock_guard<std::mutex> lock(mutex);
+  write_buffer();
+  std::fflush(file);
+}
+
+void GatewayRecorder::write_buffer() {
+  if (buffer.empty()) return;
+  if (std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+    LOG_ERROR("Failed to write gateway capture: " << std::strerror(errno));
+  }
+  buffer.clear();
+}
+
+GatewayReader::GatewayReader(const std::string &path) : path(path) {
+  file = std::fopen(path.c_str(), "rb");
+  if (!file) return;
+  char magic[sizeof(MAGIC) - 1];
+  if (std::fread(magic, 1, sizeof(magic), file) != sizeof(magic) || std::memcmp(magic, MAGIC, sizeof(magic)) != 0) {
+    LOG_ERROR(path << " is not a gateway capture");
+    std::fclose(file);
+    file = nullptr;
+    return;
+  }
+  valid = sizeof(magic);
+}
+
+GatewayReader::~GatewayReader() {
+  if (file) std::fclose(file);
+}
+
+std::optional<GatewayRecord> GatewayReader::next() {
+  if (!file) return std::nullopt;
+  const std::optional<uint64_t> delay = getVarint(file);
+  const int event = delay ? std::fgetc(file) : EOF;
+  const std::optional<uint64_t> length = event != EOF ? getVarint(file) : std::nullopt;
+  if (!length) return std::nullopt;
+
+  if (event < static_cast<int>(GatewayEvent::MessageCreate) || event > static_cast<int>(GatewayEvent::InteractionCreate) ||
+      *length > MAX_RECORD_BYTES) {
+    LOG_ERROR(path << " is damaged after " << valid << " bytes, ignoring the rest");
+    std::fclose(file);
+    file = nullptr;
+    return std::nullopt;
+  }
+
+  GatewayRecord record{std::chrono::microseconds(*delay), static_cast<GatewayEvent>(event), std::string(*length, '\0')};
+  if (std::fread(record.raw.data(), 1, record.raw.size(), file) != record.raw.size()) return std::nullopt;
+  valid = static_cast<uint64_t>(std::ftell(file));
+  return record;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <optional>
+#include <string>
+
+// Gateway events a capture holds, stored as one byte per record
+enum class GatewayEvent : uint8_t { MessageCreate = 1, ReactionAdd = 2, ReactionRemove = 3, InteractionCreate = 4 };
+
+// One captured event, `raw` is the payload exactly as DPP received it
+struct GatewayRecord {
+  std::chrono::microseconds delay; // Since the previous record
+  GatewayEvent event;
+  std::string raw;
+};
+
+// Appends gateway events to a capture file for gateway_replay, continuing an existing capture
+// Records are a varint delay, the event byte, a varint length and the raw payload
+class GatewayRecorder {
+public:
+  explicit GatewayRecorder(const std::string &path);
+  ~GatewayRecorder();
+
+  GatewayRecorder(const GatewayRecorder &) = delete;
+  GatewayRecorder &operator=(const GatewayRecorder &) = delete;
+
+  bool is_open() const { return file != nullptr; }
+
+  // Called on the gateway thread, only copies into the buffer unless it is full
+  void record(GatewayEvent event, const std::string &raw);
+
+  // Write buffered records to the file
+  void flush();
+
+private:
+  void write_buffer(); // Caller holds mutex
+
+  std::mutex mutex;
+  std::FILE *file = nullptr;
+  std::string buffer;
+  std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+};
+
+// Reads a capture written by GatewayRecorder, record by record
+class GatewayReader {
+public:
+  explicit GatewayReader(const std::string &path);
+  ~GatewayReader();
+
+  GatewayReader(const GatewayReader &) = delete;
+  GatewayReader &operator=(const GatewayReader &) = delete;
+
+  bool is_open() const { return file != nullptr; }
+
+  // Next record, nothing at the end of the file, at a truncated record or at a damaged one
+  std::optional<GatewayRecord> next();
+
+  // Bytes up to the end of the last record next() returned, including the header
+  uint64_t valid_bytes() const { return valid; }
+
+private:
+  const std::string path;
+  std::FILE *file = nullptr;
+  uint64_t valid = 0;
+};
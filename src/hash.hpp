@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+// FNV-1a, stable across builds unlike std::hash, for names and keys that outlive the process
+class Fnv1a {
+public:
+  Fnv1a &add(std::string_view data) {
+    for (const unsigned char c : data) {
+      hash = (hash ^ c) * 1099511628211ull;
+    }
+    return *this;
+  }
+
+  uint64_t value() const { return hash; }
+
+  // 16 lowercase hex digits
+  std::string hex() const {
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+    return text;
+  }
+
+private:
+  uint64_t hash = 14695981039346656037ull;
+};
@@ -0,0 +1,10 @@
+#include "main.hpp"
+#include "logger.hpp"
+
+// Log errors from DPP
+void logCallback( const dpp::confirmation_callback_t callback ) {
+  if ( callback.is_error() ) {
+    LOG_ERROR( callback.get_error().human_readable );
+  }
+}
+
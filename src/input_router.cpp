@@ -0,0 +1,62 @@
+#include "input_router.hpp"
+
+void InputRouter::await(dpp::snowflake user, dpp::snowflake channel, std::chrono::milliseconds timeout, Handler handler) {
+  const Key key{user, channel};
+  auto waiter = std::make_shared<Waiter>();
+  waiter->handler = std::move(handler);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (auto it = waiters.find(key); it != waiters.end()) {
+    scheduler.cancel(it->second->expiry);
+    it->second = waiter;
+  } else {
+    waiters.emplace(key, waiter);
+    count++;
+  }
+
+  // The expiry only removes the waiter it was scheduled for, not one that replaced it
+  waiter->expiry = scheduler.schedule(timeout, [this, key, weak = std::weak_ptr<Waiter>(waiter)]() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (const auto waiter = weak.lock()) remove(key, waiter);
+  });
+}
+
+bool InputRouter::cancel(dpp::snowflake user, dpp::snowflake channel) {
+  std::lock_guard<std::mutex> lock(mutex);
+  const auto it = waiters.find({user, channel});
+  if (it == waiters.end()) return false;
+  scheduler.cancel(it->second->expiry);
+  waiters.erase(it);
+  count--;
+  return true;
+}
+
+bool InputRouter::route(const dpp::message_create_t &event) {
+  if (count.load() == 0) return false;
+
+  const Key key{event.msg.author.id, event.msg.channel_id};
+  std::shared_ptr<Waiter> waiter;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto it = waiters.find(key);
+    if (it == waiters.end()) return false;
+    waiter = it->second;
+  }
+
+  // Run the handler without the table lock, other users' input isn't held up by it
+  std::lock_guard<std::mutex> waiter_lock(waiter->mutex);
+  if (waiter->done || !waiter->handler(event)) return false;
+  waiter->done = true;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (remove(key, waiter)) scheduler.cancel(waiter->expiry);
+  return true;
+}
+
+bool InputRouter::remove(const Key &key, const std::shared_ptr<Waiter> &waiter) {
+  const auto it = waiters.find(key);
+  if (it == waiters.end() || it->second != waiter) return false;
+  waiters.erase(it);
+  count--;
+  return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "scheduler.hpp"
+#include <atomic>
+#include <chrono>
+#include <dpp/dpp.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Hands the next message from a user in a channel to whoever is waiting for it, through one message handler
+class InputRouter {
+public:
+  // Returns true if the message was the expected input, false to keep waiting
+  using Handler = std::function<bool(const dpp::message_create_t &)>;
+
+  explicit InputRouter(Scheduler &scheduler) : scheduler(scheduler) {}
+
+  // Wait for input from `user` in `channel`, replacing an earlier wait and giving up after `timeout`
+  void await(dpp::snowflake user, dpp::snowflake channel, std::chrono::milliseconds timeout, Handler handler);
+
+  bool cancel(dpp::snowflake user, dpp::snowflake channel);
+
+  // Offer a message to its waiter, returns true if it was consumed
+  bool route(const dpp::message_create_t &event);
+
+private:
+  struct Key {
+    dpp::snowflake user;
+    dpp::snowflake channel;
+    bool operator==(const Key &other) const = default;
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const {
+      return std::hash<uint64_t>()(static_cast<uint64_t>(key.user) * 0x9E3779B97F4A7C15ull ^ key.channel);
+    }
+  };
+
+  struct Waiter {
+    Handler handler;
+    Scheduler::Handle expiry = 0;
+    std::mutex mutex; // Held while the handler runs, so two messages can't both be consumed
+    bool done = false;
+  };
+
+  // Remove the waiter for `key` if it is still `waiter`, caller holds mutex
+  bool remove(const Key &key, const std::shared_ptr<Waiter> &waiter);
+
+  Scheduler &scheduler;
+
+  std::mutex mutex;
+  std::unordered_map<Key, std::shared_ptr<Waiter>, KeyHash> waiters;
+  std::atomic<size_t> count{0}; // Lets route() skip the lock while nobody is waiting
+};
@@ -0,0 +1,148 @@
+#include "keyword_matcher.hpp"
+#include <algorithm>
+#include <queue>
+
+KeywordMatcher::KeywordMatcher(const std::map<std::string, std::string> &text,
+                               const std::map<std::string, std::string> &files) {
+  for (const auto &[keyword, response] : text) {
+    keywords.push_back({keyword, response, Kind::Text});
+  }
+  for (const auto &[keyword, response] : files) {
+    keywords.push_back({keyword, response, Kind::File});
+  }
+
+  // Assign a symbol to every byte that appears in a keyword
+  for (const auto &k : keywords) {
+    for (const unsigned char c : k.keyword) {
+      if (symbols[c] == 0) {
+        symbols[c] = static_cast<uint16_t>(alphabet++);
+      }
+    }
+  }
+
+  nodes.emplace_back();
+  transitions.assign(alphabet, 0);
+  for (uint32_t id = 0; id < keywords.size(); id++) {
+    const std::string &keyword = keywords[id].keyword;
+    if (keyword.empty()) {
+      always.push_back(id);
+      continue;
+    }
+
+    // Insert the keyword into the trie
+    uint32_t state = 0;
+    for (const unsigned char c : keyword) {
+      uint32_t &next = transitions[state * alphabet + symbols[c]];
+      if (next == 0) {
+        next = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+        transitions.resize(nodes.size() * alphabet, 0);
+      }
+      state = transitions[state * alphabet + symbols[c]];
+    }
+    nodes[state].outputs.push_back(id);
+  }
+
+  build();
+}
+
+void KeywordMatcher::build() {
+  // Breadth-first pass filling in fail links and turning the trie into a full DFA
+  std::queue<uint32_t> queue;
+  for (size_t s = 1; s < alphabet; s++) {
+    if (const uint32_t child = transitions[s]; child != 0) {
+      queue.push(child);
+    }
+  }
+
+  while (!queue.empty()) {
+    const uint32_t state = queue.front();
+    queue.pop();
+    for (size_t s = 1; s < alphabet; s++) {
+      const uint32_t child = transitions[state * alphabet + s];
+      const uint32_t fallback = transitions[nodes[state].fail * alphabet + s];
+      if (child == 0) {
+        transitions[state * alphabet + s] = fallback;
+        continue;
+      }
+      nodes[child].fail = fallback;
+      nodes[child].dict = nodes[fallback].outputs.empty() ? nodes[fallback].dict : fallback;
+      queue.push(child);
+    }
+  }
+}
+
+std::vector<const KeywordMatcher::Keyword *> KeywordMatcher::match(std::string_view content) const {
+  std::vector<bool> found(keywords.size(), false);
+  for (const uint32_t id : always) {
+    found[id] = true;
+  }
+
+  if (nodes.size() > 1) {
+    uint32_t state = 0;
+    for (const unsigned char c : content) {
+      state = transitions[state * alphabet + symbols[c]];
+      for (uint32_t hit = nodes[state].outputs.empty() ? nodes[state].dict : state; hit != 0; hit = nodes[hit].dict) {
+        for (const uint32_t id : nodes[hit].outputs) {
+          found[id] = true;
+        }
+      }
+    }
+  }
+
+  std::vector<const Keyword *> matches;
+  for (size_t id = 0; id < keywords.size(); id++) {
+    if (found[id]) {
+      matches.push_back(&keywords[id]);
+    }
+  }
+  return matches;
+}
+
+std::shared_ptr<const KeywordIndex::Layer> KeywordIndex::makeLayer(std::map<std::string, std::string> text,
+                                                                   std::map<std::string, std::string> files) {
+  auto layer = std::make_shared<Layer>();
+  layer->matcher = KeywordMatcher(text, files);
+  layer->text = std::move(text);
+  layer->files = std::move(files);
+  return layer;
+}
+
+KeywordIndex::KeywordIndex(std::map<std::string, std::string> text, std::map<std::string, std::string> files)
+    : base(makeLayer(std::move(text), std::move(files))), recent(makeLayer({}, {})) {}
+
+KeywordIndex KeywordIndex::with(const std::string &keyword, const std::string &response, Kind kind) const {
+  std::map<std::string, std::string> text = recent->text;
+  std::map<std::string, std::string> files = recent->files;
+  (kind == Kind::Text ? text : files)[keyword] = response;
+
+  KeywordIndex index;
+  if (text.size() + files.size() <= MAX_RECENT) {
+    index.base = base;
+    index.recent = makeLayer(std::move(text), std::move(files));
+    return index;
+  }
+
+  // Fold the edits into a new shared automaton, once every MAX_RECENT edits
+  std::map<std::string, std::string> all_text = base->text;
+  std::map<std::string, std::string> all_files = base->files;
+  for (auto &[k, v] : text) all_text[k] = std::move(v);
+  for (auto &[k, v] : files) all_files[k] = std::move(v);
+  return KeywordIndex(std::move(all_text), std::move(all_files));
+}
+
+std::vector<const KeywordIndex::Keyword *> KeywordIndex::match(std::string_view content) const {
+  std::vector<const Keyword *> matches = recent->matcher.match(content);
+  if (matches.empty() && recent->text.empty() && recent->files.empty()) return base->matcher.match(content);
+
+  for (const Keyword *keyword : base->matcher.match(content)) {
+    const auto &shadowing = keyword->kind == Kind::Text ? recent->text : recent->files;
+    if (!shadowing.contains(keyword->keyword)) {
+      matches.push_back(keyword);
+    }
+  }
+  std::sort(matches.begin(), matches.end(), [](const Keyword *a, const Keyword *b) {
+    return a->kind != b->kind ? a->kind < b->kind : a->keyword < b->keyword;
+  });
+  return matches;
+}
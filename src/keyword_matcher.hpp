@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Aho-Corasick automaton over the configured keywords, scans a message once for all of them
+class KeywordMatcher {
+public:
+  enum class Kind { Text, File };
+
+  struct Keyword {
+    std::string keyword;
+    std::string response; // Reply text or media filename, depending on kind
+    Kind kind;
+  };
+
+  KeywordMatcher() = default;
+  KeywordMatcher(const std::map<std::string, std::string> &text, const std::map<std::string, std::string> &files);
+
+  // Keywords contained in `content`, text keywords first and each group in keyword order
+  std::vector<const Keyword *> match(std::string_view content) const;
+
+  size_t size() const { return keywords.size(); }
+
+private:
+  struct Node {
+    uint32_t fail = 0;
+    uint32_t dict = 0; // Nearest node on the fail chain that ends a keyword, 0 if none
+    std::vector<uint32_t> outputs;
+  };
+
+  void build();
+
+  std::vector<Keyword> keywords;
+  std::vector<uint32_t> always; // Empty keywords match every message
+
+  // Bytes used by any keyword are mapped to a dense alphabet, everything else is symbol 0
+  std::array<uint16_t, 256> symbols{};
+  size_t alphabet = 1;
+  std::vector<Node> nodes;
+  std::vector<uint32_t> transitions; // nodes.size() * alphabet, complete after build()
+};
+
+// Keywords as a shared automaton over most of them plus a small one over recent edits, so an edit only rebuilds the
+// small one. Edits are folded into the shared automaton once there are more than MAX_RECENT of them.
+class KeywordIndex {
+public:
+  using Keyword = KeywordMatcher::Keyword;
+  using Kind = KeywordMatcher::Kind;
+
+  static constexpr size_t MAX_RECENT = 64;
+
+  KeywordIndex() = default;
+  KeywordIndex(std::map<std::string, std::string> text, std::map<std::string, std::string> files);
+
+  // A copy with `keyword` set to `response`, sharing the large automaton with this one
+  KeywordIndex with(const std::string &keyword, const std::string &response, Kind kind) const;
+
+  // Keywords contained in `content`, text keywords first and each group in keyword order
+  std::vector<const Keyword *> match(std::string_view content) const;
+
+private:
+  struct Layer {
+    std::map<std::string, std::string> text;
+    std::map<std::string, std::string> files;
+    KeywordMatcher matcher; // Built from text and files
+  };
+
+  static std::shared_ptr<const Layer> makeLayer(std::map<std::string, std::string> text,
+                                                std::map<std::string, std::string> files);
+
+  std::shared_ptr<const Layer> base = makeLayer({}, {});
+  std::shared_ptr<const Layer> recent = base; // Wins over base for keywords in both
+};
@@ -0,0 +1,129 @@
+#include "logger.hpp"
+#include <cstdio>
+#include <ctime>
+
+namespace {
+
+const char *levelName(LogLevel level) {
+  switch (level) {
+  case LogLevel::Debug:
+    return "DEBUG";
+  case LogLevel::Info:
+    return "INFO";
+  case LogLevel::Warning:
+    return "WARN";
+  case LogLevel::Error:
+    return "ERROR";
+  }
+  return "";
+}
+
+} // namespace
+
+LogLevel parseLogLevel(const std::string &name) {
+  if (name == "debug") return LogLevel::Debug;
+  if (name == "warning") return LogLevel::Warning;
+  if (name == "error") return LogLevel::Error;
+  return LogLevel::Info;
+}
+
+Logger &Logger::instance() {
+  static Logger logger;
+  return logger;
+}
+
+Logger::Logger() : slots(new Slot[CAPACITY]) {
+  for (size_t i = 0; i < CAPACITY; i++) {
+    slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  thread = std::thread([this]() { run(); });
+}
+
+Logger::~Logger() {
+  stopping.store(true);
+  signal.fetch_add(1);
+  signal.notify_one();
+  thread.join();
+}
+
+void Logger::write(LogLevel level, std::string message) {
+  // Claim a free slot, bounded MPMC queue after Vyukov
+  size_t position = head.load(std::memory_order_relaxed);
+  Slot *slot;
+  while (true) {
+    slot = &slots[position & (CAPACITY - 1)];
+    const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+    if (diff == 0) {
+      if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      overflow.fetch_add(1, std::memory_order_relaxed); // The writer is a full ring behind
+      return;
+    } else {
+      position = head.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->record = {level, std::chrono::system_clock::now(), std::move(message)};
+  slot->sequence.store(position + 1, std::memory_order_release);
+  signal.fetch_add(1, std::memory_order_release);
+  signal.notify_one();
+}
+
+void Logger::flush(std::chrono::milliseconds timeout) {
+  const size_t target = head.load(std::memory_order_acquire);
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (written.load(std::memory_order_acquire) < target && std::chrono::steady_clock::now() < deadline) {
+    signal.fetch_add(1, std::memory_order_release);
+    signal.notify_one();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+bool Logger::pop(Record &record) {
+  Slot &slot = slots[tail & (CAPACITY - 1)];
+  if (slot.sequence.load(std::memory_order_acquire) != tail + 1) return false;
+  record = std::move(slot.record);
+  slot.sequence.store(tail + CAPACITY, std::memory_order_release);
+  tail++;
+  return true;
+}
+
+void Logger::run() {
+  uint64_t reported = 0;
+  std::string out;
+  std::string err;
+  Record record;
+  while (true) {
+    const uint32_t seen = signal.load(std::memory_order_acquire);
+
+    // Format a whole batch, then write each stream once
+    while (pop(record)) {
+      const std::time_t time = std::chrono::system_clock::to_time_t(record.time);
+      std::tm tm;
+      localtime_r(&time, &tm);
+      char stamp[32];
+      std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+      std::string &target = record.level == LogLevel::Error ? err : out;
+      target += std::string(stamp) + " [" + levelName(record.level) + "] " + record.message + "\n";
+    }
+    if (const uint64_t dropped = overflow.load(std::memory_order_relaxed); dropped != reported) {
+      err += "[WARN] Log buffer full, dropped " + std::to_string(dropped - reported) + " records\n";
+      reported = dropped;
+    }
+    if (!out.empty()) {
+      std::fwrite(out.data(), 1, out.size(), stdout);
+      std::fflush(stdout);
+      out.clear();
+    }
+    if (!err.empty()) {
+      std::fwrite(err.data(), 1, err.size(), stderr);
+      std::fflush(stderr);
+      err.clear();
+    }
+    written.store(tail, std::memory_order_release);
+
+    if (stopping.load() && slots[tail & (CAPACITY - 1)].sequence.load(std::memory_order_acquire) != tail + 1) return;
+    signal.wait(seen, std::memory_order_acquire);
+  }
+}
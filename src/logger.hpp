@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+enum class LogLevel { Debug, Info, Warning, Error };
+
+// "debug", "info", "warning" or "error", anything else is Info
+LogLevel parseLogLevel(const std::string &name);
+
+// Process-wide logger, records go through a lock-free ring buffer to one writer thread
+class Logger {
+public:
+  static Logger &instance();
+
+  // Checked by the LOG_ macros before the message is formatted
+  bool enabled(LogLevel level) const { return level >= min_level.load(std::memory_order_relaxed); }
+  void set_level(LogLevel level) { min_level.store(level, std::memory_order_relaxed); }
+
+  // Queue a record, dropped and counted if the ring buffer is full
+  void write(LogLevel level, std::string message);
+
+  uint64_t dropped() const { return overflow.load(std::memory_order_relaxed); }
+
+  // Wait up to `timeout` for the records queued so far to be written out, before the process exits
+  void flush(std::chrono::milliseconds timeout = std::chrono::milliseconds(1000));
+
+private:
+  struct Record {
+    LogLevel level;
+    std::chrono::system_clock::time_point time;
+    std::string message;
+  };
+
+  struct Slot {
+    std::atomic<size_t> sequence; // Equals the position when free, position + 1 when it holds a record
+    Record record;
+  };
+
+  static constexpr size_t CAPACITY = 4096; // Power of two
+
+  Logger();
+  ~Logger();
+
+  bool pop(Record &record);
+  void run();
+
+  std::atomic<LogLevel> min_level{LogLevel::Info};
+  std::unique_ptr<Slot[]> slots;
+  alignas(64) std::atomic<size_t> head{0}; // Next position producers claim
+  alignas(64) size_t tail = 0;             // Next position the writer reads
+  std::atomic<size_t> written{0};          // Records written out, for flush()
+  std::atomic<uint32_t> signal{0};         // Bumped after every write, the writer sleeps on it
+  std::atomic<uint64_t> overflow{0};
+  std::atomic<bool> stopping{false};
+  std::thread thread;
+};
+
+#define LOG_AT(level, msg)                                                                                             \
+  do {                                                                                                                 \
+    if (Logger::instance().enabled(level)) {                                                                           \
+      std::ostringstream log_stream_;                                                                                  \
+      log_stream_ << msg;                                                                                              \
+      Logger::instance().write(level, log_stream_.str());                                                              \
+    }                                                                                                                  \
+  } while (0)
+
+#define LOG_DEBUG(msg) LOG_AT(LogLevel::Debug, msg)
+#define LOG_INFO(msg) LOG_AT(LogLevel::Info, msg)
+#define LOG_WARNING(msg) LOG_AT(LogLevel::Warning, msg)
+#define LOG_ERROR(msg) LOG_AT(LogLevel::Error, msg)
@@ -1,58 +1,44 @@
-// #define VERBOSE_DEBUG
-
 #include "main.hpp"
-#include "events/event.hpp"
-#include "events/events_registry.hpp"
 #include "commands/command.hpp"
 #include "commands/commands_registry.hpp"
+#include "dispatch.hpp"
+#include "plugin_loader.hpp"
 #include "starboard.hpp"
+#include "logger.hpp"
+#include "metrics_server.hpp"
 
 #include <boost/asio.hpp>
 #include <concepts>
 #include <csignal>
+#include <cstdlib>
 #include <dpp/dpp.h>
 #include <filesystem>
 #include <fstream>
 #include <memory>
 #include <nlohmann/json.hpp>
+#include <pthread.h>
 #include <regex>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
 using json = nlohmann::json;
 namespace fs = std::filesystem;
 
-#ifdef VERBOSE_DEBUG
-#define LOG_DEBUG( msg ) std::cout << "[DEBUG] " << msg << std::endl
-#else
-#define LOG_DEBUG( msg )
-#endif
-
-// Exit gracefully on signal
-void signalHandler( int signal ) {
-  std::cout << "Caught signal " << signal << ", exiting..." << std::endl;
-  exit( 0 );
-}
-
-void callAsThread( std::function<void()> func ) {
-  std::thread( func ).detach();
-}
-
-// Log errors from DPP
-void logCallback( const dpp::confirmation_callback_t callback ) {
-  if ( callback.is_error() ) {
-    std::cerr << "Error: " << callback.get_error().human_readable << std::endl;
-  }
-}
-
-void deleteAfterAsync( custom_cluster &bot, dpp::snowflake msgid, dpp::snowflake channelid, int seconds ) {
-  LOG_DEBUG( "Scheduling message deletion in " + std::to_string( seconds ) + " seconds" );
-  std::thread( [&bot, msgid, channelid, seconds]() {
-    LOG_DEBUG( "Starting deleteAfterAsync thread" );
-    std::this_thread::sleep_for( std::chrono::seconds( seconds ) );
-    LOG_DEBUG( "Deleting message after " + std::to_string( seconds ) + " seconds" );
-    bot.message_delete( msgid, channelid, logCallback );
+// Exit on signal, on a thread of its own so it can take locks and write files
+// Other threads keep running until the end, so the process exits without running static destructors they still use
+void handleSignals( const sigset_t &signals, custom_cluster &bot, GatewayRecorder *recorder ) {
+  std::thread( [ signals, &bot, recorder ]() {
+    int signal = 0;
+    sigwait( &signals, &signal );
+    LOG_INFO( "Caught signal " << signal << ", exiting..." );
+    if ( recorder ) {
+      recorder->flush();
+    }
+    bot.persist_state();
+    Logger::instance().flush();
+    std::_Exit( 0 );
   } ).detach();
 }
 
@@ -93,19 +79,23 @@ void log_websocket_message( const std::string &raw_message ) {
       break;
     }
   } catch ( const std::exception &e ) {
-    std::cerr << "[ERROR] Failed to parse WebSocket message: " << e.what() << std::endl;
+    LOG_ERROR( "Failed to parse WebSocket message: " << e.what() );
   }
 }
 
 int main() {
-  LOG_DEBUG( "Initializing signal handler" );
-  std::signal( SIGINT, signalHandler );
+  // Blocked before any thread starts, so every thread inherits the mask and only the signal thread receives them
+  sigset_t signals;
+  sigemptyset( &signals );
+  sigaddset( &signals, SIGINT );
+  sigaddset( &signals, SIGTERM );
+  pthread_sigmask( SIG_BLOCK, &signals, nullptr );
 
   LOG_DEBUG( "Loading config" );
   std::ifstream cfg_fstream;
   cfg_fstream.open( "../config.json", std::fstream::in );
   if ( !cfg_fstream.is_open() ) {
-    std::cerr << "Failed to open config.json" << std::endl;
+    LOG_ERROR( "Failed to open config.json" );
     return 1;
   }
   json config = json::parse( cfg_fstream );
@@ -113,21 +103,28 @@ int main() {
 
   custom_cluster bot( config.at( "token" ), dpp::intents::i_all_intents );
   bot.load_config();
-  bot.on_log( dpp::utility::cout_logger() );
 
   LOG_DEBUG( "Loading commands" );
-  // Get commands from the command registry
-  std::vector<std::unique_ptr<Command>> commands = CommandRegistry::instance().create_all_commands();
-  LOG_DEBUG( "Loaded " + std::to_string(commands.size()) + " commands" );
-
-  LOG_DEBUG( "Loading events" );
-  // Get events from the event registry
-  std::vector<std::unique_ptr<Event>> events = EventRegistry::instance().create_all_events();
-  LOG_DEBUG( "Loaded " + std::to_string(events.size()) + " events" );
-
-  bot.on_log( [ &bot ]( const dpp::log_t &event ) {
-    if ( event.severity == dpp::loglevel::ll_error ) {
-      std::cerr << "Error: " << event.message << std::endl;
+  // Get commands from the command registry, then let plugins add to or replace them
+  auto builtin = std::make_shared<custom_cluster::CommandTable>();
+  for ( auto &command : CommandRegistry::instance().create_all_commands() ) {
+    std::string name = command->get_name();
+    ( *builtin )[ name ] = std::move( command );
+  }
+  bot.set_commands( std::move( builtin ) );
+  PluginLoader plugins( bot );
+  LOG_DEBUG( "Loaded " + std::to_string( bot.get_commands()->size() ) + " commands" );
+
+  // Map DPP's severities onto ours, the level is checked before a websocket frame is parsed
+  bot.on_log( []( const dpp::log_t &event ) {
+    if ( event.severity >= dpp::loglevel::ll_error ) {
+      LOG_ERROR( event.message );
+    } else if ( event.severity == dpp::loglevel::ll_warning ) {
+      LOG_WARNING( event.message );
+    } else if ( event.severity == dpp::loglevel::ll_info ) {
+      LOG_INFO( event.message );
+    } else if ( !Logger::instance().enabled( LogLevel::Debug ) ) {
+      return;
     } else if ( event.message.rfind( "W:", 0 ) == 0 ) { // Check if the log starts with "W:"
       log_websocket_message( event.message );
     } else {
@@ -135,64 +132,62 @@ int main() {
     }
   } );
 
-  // Set up event handlers
-  bot.on_ready( [ &bot, &events ]( const dpp::ready_t &event ) {
-    for ( const auto &e : events ) {
-      if ( e->get_name() == "ready" ) {
-        callAsThread( [ &bot, &e, event ]() { e->execute( bot, event ); } );
-        break;
-      }
-    }
-  } );
-
-  bot.on_message_create( [ &bot, &events ]( const dpp::message_create_t &event ) {
-    for ( const auto &e : events ) {
-      if ( e->get_name() == "message_create" ) {
-        callAsThread( [ &bot, &e, event ]() { e->execute( bot, event ); } );
-        break;
-      }
-    }
-  } );
-
-  bot.on_message_reaction_add( [ &bot, &events ]( const dpp::message_reaction_add_t &event ) {
-    for ( const auto &e : events ) {
-      if ( e->get_name() == "reaction" ) {
-        callAsThread( [ &bot, &e, event ]() { e->execute( bot, event ); } );
-        break;
-      }
-    }
-  } );
-
-  bot.on_message_reaction_remove( [ &bot, &events ]( const dpp::message_reaction_remove_t &event ) {
-    for ( const auto &e : events ) {
-      if ( e->get_name() == "reaction" ) {
-        callAsThread( [ &bot, &e, event ]() { e->execute( bot, event ); } );
-        break;
-      }
-    }
-  } );
+  // Set up event handlers, recording them first if a capture file is configured
+  std::unique_ptr<GatewayRecorder> recorder;
+  if ( !bot.get_config()->gateway_record_file.empty() ) {
+    recorder = std::make_unique<GatewayRecorder>( bot.get_config()->gateway_record_file );
+    bot.start_timer( [ &recorder ]( dpp::timer ) { recorder->flush(); }, 5 );
+  }
+  registerHandlers( bot, recorder.get() );
 
-  // Execute slash command if it's allowed in the channel
-  bot.on_slashcommand( [ &bot, &commands ]( const dpp::slashcommand_t &event ) {
-    for ( const auto &command : commands ) {
-      if ( event.command.get_command_name() == command->get_name() ) {
-        LOG_DEBUG( "Executing slash command: " + command->get_name() );
-
-        // Get channel ID and check if it's allowed
-        dpp::snowflake channel_id = event.command.channel_id;
-        json config = bot.get_config();
-        std::vector<dpp::snowflake> channel_ids = config.at( "botChannels" );
-        if ( std::find( channel_ids.begin(), channel_ids.end(), channel_id ) != channel_ids.end() ) {
-          // Execute the command if it's allowed
-          callAsThread( [ &bot, event, &command ]() { command->execute( bot, event ); } );
-        } else {
-          // Send an ephemeral message if it's not allowed
-          event.reply( dpp::message( "No." ).set_flags( dpp::m_ephemeral ) );
-        }
-        break;
-      }
-    }
-  } );
+  LOG_DEBUG( "Initializing signal handler" );
+  handleSignals( signals, bot, recorder.get() );
+
+  LOG_DEBUG( "Loaded " + std::to_string( bot.starboard.store.size() ) + " starboard posts" );
+
+  // Compact the starboard store every 10 minutes, it only rewrites once dead records dominate
+  bot.start_timer( [ &bot ]( dpp::timer ) { bot.starboard.store.compact(); }, 600 );
+
+  // Sync starboard appends in batches rather than one fdatasync per post edit
+  bot.start_timer( [ &bot ]( dpp::timer ) { bot.starboard.store.sync(); }, 5 );
+
+  // Report executor load and starboard edit coalescing once a minute
+  bot.start_timer(
+      [ &bot ]( dpp::timer ) {
+        const Executor::Stats stats = bot.executor.stats();
+        const StarboardIndex::Stats starboard = bot.starboard.stats();
+        LOG_DEBUG( "Executor: " + std::to_string( bot.executor.size() ) + " workers, " + std::to_string( stats.queued ) +
+                   " queued, " + std::to_string( stats.executed ) + " executed, " + std::to_string( stats.stolen ) +
+                   " stolen" );
+        LOG_DEBUG( "Starboard: " + std::to_string( starboard.edits_issued ) + " edits issued, " +
+                   std::to_string( starboard.edits_suppressed ) + " suppressed" );
+      },
+      60 );
+
+  // State other components already count, read when metrics are scraped
+  Metrics &metrics = Metrics::instance();
+  metrics.gauge( "bot_executor_queued_tasks", "Tasks waiting in executor queues",
+                 [ &bot ]() { return static_cast<double>( bot.executor.stats().queued ); } );
+  metrics.gauge(
+      "bot_executor_tasks_total", "Tasks run by the executor",
+      [ &bot ]() { return static_cast<double>( bot.executor.stats().executed ); }, true );
+  metrics.gauge(
+      "bot_executor_stolen_tasks_total", "Tasks run by a worker other than the one they were queued on",
+      [ &bot ]() { return static_cast<double>( bot.executor.stats().stolen ); }, true );
+  metrics.gauge( "bot_scheduler_pending_tasks", "Delayed tasks waiting to run",
+                 [ &bot ]() { return static_cast<double>( bot.scheduler.pending() ); } );
+  metrics.gauge(
+      "bot_starboard_edits_issued_total", "Starboard posts created or edited",
+      [ &bot ]() { return static_cast<double>( bot.starboard.edits_issued.load() ); }, true );
+  metrics.gauge(
+      "bot_starboard_edits_suppressed_total", "Reactions folded into a pending starboard update",
+      [ &bot ]() { return static_cast<double>( bot.starboard.edits_suppressed.load() ); }, true );
+  metrics.gauge(
+      "bot_log_records_dropped_total", "Log records dropped because the log buffer was full",
+      []() { return static_cast<double>( Logger::instance().dropped() ); }, true );
+
+  // Declared after the bot, so it stops serving before the state its gauges read goes away
+  MetricsServer metricsServer( bot.get_config()->metrics_port );
 
   LOG_DEBUG( "Starting bot" );
   // Start bot
@@ -1,29 +1,97 @@
 #pragma once
+#include "config.hpp"
+#include "config_store.hpp"
+#include "executor.hpp"
+#include "input_router.hpp"
+#include "logger.hpp"
+#include "media_cache.hpp"
+#include "metrics.hpp"
+#include "outbound_queue.hpp"
+#include "scheduler.hpp"
+#include "starboard_index.hpp"
+#include <atomic>
 #include <dpp/dpp.h>
-#include <fstream>
+#include <memory>
+#include <mutex>
 #include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_map>
 
 using json = nlohmann::json;
 
+class Command;
+
 class custom_cluster : public dpp::cluster {
 public:
   using dpp::cluster::cluster; // Inherit constructors
 
   void load_config() {
-    std::ifstream cfg_ifstream( "../config.json" );
-    cfg = json::parse( cfg_ifstream );
+    std::lock_guard<std::mutex> lock( cfg_write_mutex );
+    publish_config( Config::parse( config_store.load() ) );
+  }
+
+  // Set one value in the config document, publish the new snapshot and return once the edit is journaled
+  // False if journaling it failed, the edit is live and stays queued for another attempt
+  bool update_config( const json::json_pointer &pointer, json value ) {
+    uint64_t sequence;
+    {
+      const std::unique_lock<std::mutex> lock = lockTimed( cfg_write_mutex, cfg_write_wait );
+      std::shared_ptr<const Config> next = cfg.load()->with( pointer, value );
+      sequence = config_store.append( pointer, std::move( value ) );
+      if ( !next ) {
+        next = Config::parse( config_store.snapshot() );
+      }
+      publish_config( std::move( next ) );
+    }
+    // Outside the lock, so concurrent edits share one fdatasync
+    return config_store.wait( sequence );
   }
-  void save_config( json config ) {
-    std::ofstream cfg_ofstream( "../config.json", std::ofstream::out | std::ofstream::trunc );
-    cfg_ofstream << config.dump( 2 );
-    cfg = config;
+
+  // Write out state kept in memory or not yet synced, before the process exits
+  void persist_state() {
+    config_store.close();
+    starboard.store.sync();
   }
-  json get_config() { return cfg; }
 
-  std::unordered_map<std::string, dpp::message> starboard;
-  std::mutex starboard_mutex;
-  std::unordered_map<std::string, std::shared_ptr<std::thread>> starboard_threads;
+  // Current config snapshot, never modified after it has been published
+  std::shared_ptr<const Config> get_config() const { return cfg.load(); }
+
+  // Slash commands by name, replaced as a whole when plugins are loaded or unloaded
+  using CommandTable = std::unordered_map<std::string, std::shared_ptr<Command>>;
+  std::shared_ptr<const CommandTable> get_commands() const { return commands.load(); }
+  void set_commands( std::shared_ptr<const CommandTable> table ) { commands.store( std::move( table ) ); }
+
+  StarboardIndex starboard;
+
+  // Runs event and command handlers off the gateway thread
+  Executor executor;
+
+  // Messages awaited by commands, declared before the scheduler running its expiries
+  InputRouter input{ scheduler };
+
+  // Paces outgoing messages per channel, declared before the scheduler that resumes it after a rate limit
+  OutboundQueue outbound{ *this, scheduler };
+
+  // Files sent for keyWordsFiles responses
+  MediaCache media;
+
+  // Runs delayed work, declared after the state its tasks touch so it stops first
+  Scheduler scheduler;
 
 protected:
-  json cfg;
+  void publish_config( std::shared_ptr<const Config> config ) {
+    media.set_capacity( config->media_cache_bytes );
+    Logger::instance().set_level( config->log_level );
+    cfg.store( std::move( config ) );
+  }
+
+  // Edits are journaled and folded into config.json in the background
+  ConfigStore config_store;
+
+  std::atomic<std::shared_ptr<const Config>> cfg;
+  std::mutex cfg_write_mutex; // Serializes load_config and update_config
+  Histogram &cfg_write_wait = Metrics::instance().histogram( "bot_mutex_wait_seconds", "Time spent waiting for a lock",
+                                                             { { "mutex", "config_write" } } );
+
+  std::atomic<std::shared_ptr<const CommandTable>> commands{ std::make_shared<const CommandTable>() };
 };
@@ -0,0 +1,93 @@
+#include "media_cache.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sys/inotify.h>
+
+MediaCache::MediaCache(std::string directory, size_t capacity)
+    : directory(std::move(directory)), capacity(capacity),
+      watcher(this->directory, IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) {
+  if (!watcher.is_watching()) {
+    LOG_ERROR("Failed to watch " << this->directory << ", media changes need a restart");
+    return;
+  }
+  watcher.start([this](const std::string &filename, uint32_t) { invalidate(filename); });
+}
+
+std::string MediaCache::attachment_name(const std::string &filename) {
+  constexpr size_t HASH_DIGITS = 16;
+  const auto hex = [](char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'); };
+  if (filename.size() <= HASH_DIGITS + 1 || !std::all_of(filename.begin(), filename.begin() + HASH_DIGITS, hex) ||
+      (filename[HASH_DIGITS] != '-' && filename[HASH_DIGITS] != '_')) {
+    return filename;
+  }
+  const size_t dash = filename.find('-', HASH_DIGITS);
+  return dash == std::string::npos || dash + 1 == filename.size() ? filename : filename.substr(dash + 1);
+}
+
+std::shared_ptr<const std::string> MediaCache::get(const std::string &filename) {
+  uint64_t loaded_generation;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(filename);
+    if (it != entries.end()) {
+      lru.splice(lru.begin(), lru, it->second.lru);
+      return it->second.data;
+    }
+    loaded_generation = generation;
+  }
+
+  // Read outside the lock so a slow disk doesn't stall other replies
+  std::shared_ptr<const std::string> data = load(filename);
+  if (!data) return nullptr;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (generation != loaded_generation || data->size() > capacity || entries.contains(filename)) {
+    return data;
+  }
+  lru.push_front(filename);
+  entries[filename] = {data, lru.begin()};
+  used += data->size();
+  evict();
+  return data;
+}
+
+void MediaCache::set_capacity(size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex);
+  capacity = bytes;
+  evict();
+}
+
+void MediaCache::invalidate(const std::string &filename) {
+  std::lock_guard<std::mutex> lock(mutex);
+  generation++;
+  auto it = entries.find(filename);
+  if (it == entries.end()) return;
+  used -= it->second.data->size();
+  lru.erase(it->second.lru);
+  entries.erase(it);
+}
+
+std::shared_ptr<const std::string> MediaCache::load(const std::string &filename) const {
+  std::ifstream f(directory + "/" + filename, std::ios::binary);
+  if (!f) return nullptr;
+
+  // Read the file straight into the string that gets shared with every reply
+  f.seekg(0, std::ios::end);
+  const std::streamsize length = f.tellg();
+  f.seekg(0, std::ios::beg);
+  if (length < 0) return nullptr;
+
+  std::string content(static_cast<size_t>(length), '\0');
+  if (!f.read(content.data(), length)) return nullptr;
+  return std::make_shared<const std::string>(std::move(content));
+}
+
+void MediaCache::evict() {
+  while (used > capacity && !lru.empty()) {
+    auto it = entries.find(lru.back());
+    used -= it->second.data->size();
+    entries.erase(it);
+    lru.pop_back();
+  }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "directory_watcher.hpp"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// LRU cache of keyword media files, invalidated through inotify when files in the directory change
+class MediaCache {
+public:
+  explicit MediaCache(std::string directory = "../media", size_t capacity = 64 * 1024 * 1024);
+  MediaCache(const MediaCache &) = delete;
+  MediaCache &operator=(const MediaCache &) = delete;
+
+  // File contents, read from disk on a miss; nullptr if the file can't be read
+  std::shared_ptr<const std::string> get(const std::string &filename);
+
+  // Maximum bytes kept in memory, files larger than this are read on every request
+  void set_capacity(size_t bytes);
+
+  void invalidate(const std::string &filename);
+
+  // Name to attach a stored file under: /keywordfile stores uploads as <content hash>[_<n>]-<uploaded name>, this is
+  // the uploaded name. Other files keep their own name
+  static std::string attachment_name(const std::string &filename);
+
+private:
+  struct Entry {
+    std::shared_ptr<const std::string> data;
+    std::list<std::string>::iterator lru;
+  };
+
+  std::shared_ptr<const std::string> load(const std::string &filename) const;
+  void evict(); // Caller holds mutex
+
+  const std::string directory;
+
+  std::mutex mutex;
+  std::unordered_map<std::string, Entry> entries;
+  std::list<std::string> lru; // Most recently used first
+  size_t capacity;
+  size_t used = 0;
+  uint64_t generation = 0; // Bumped on every invalidation so stale loads are not inserted
+
+  DirectoryWatcher watcher; // Last, so it stops before the state it invalidates goes away
+};
@@ -0,0 +1,173 @@
+#include "metrics.hpp"
+#include <sched.h>
+#include <sstream>
+#include <unordered_map>
+
+namespace {
+
+size_t currentShard() {
+  const int cpu = sched_getcpu();
+  return cpu < 0 ? 0 : static_cast<size_t>(cpu) & (METRIC_SHARDS - 1);
+}
+
+std::string escapeLabel(const std::string &value) {
+  std::string escaped;
+  for (const char c : value) {
+    if (c == '\\' || c == '"') {
+      escaped += '\\';
+      escaped += c;
+    } else if (c == '\n') {
+      escaped += "\\n";
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+// Label pairs as they appear between the braces, e.g. event="ready",route="x"
+std::string renderLabels(const Metrics::Labels &labels) {
+  std::string rendered;
+  for (const auto &[key, value] : labels) {
+    if (!rendered.empty()) rendered += ',';
+    rendered += key + "=\"" + escapeLabel(value) + "\"";
+  }
+  return rendered;
+}
+
+std::string series(const std::string &name, const std::string &labels, const std::string &extra = "") {
+  const std::string all = labels.empty() ? extra : extra.empty() ? labels : labels + "," + extra;
+  return all.empty() ? name : name + "{" + all + "}";
+}
+
+} // namespace
+
+void Counter::add(uint64_t n) { cells[currentShard()].value.fetch_add(n, std::memory_order_relaxed); }
+
+uint64_t Counter::value() const {
+  uint64_t total = 0;
+  for (const Cell &cell : cells) {
+    total += cell.value.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+void Histogram::observe(std::chrono::nanoseconds duration) {
+  const double seconds = std::chrono::duration<double>(duration).count();
+  size_t bucket = 0;
+  while (bucket < BOUNDS.size() && seconds > BOUNDS[bucket]) bucket++;
+
+  Cell &cell = cells[currentShard()];
+  cell.counts[bucket].fetch_add(1, std::memory_order_relaxed);
+  cell.sum_ns.fetch_add(static_cast<uint64_t>(std::max<int64_t>(0, duration.count())), std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+  Snapshot snapshot{};
+  uint64_t sum_ns = 0;
+  for (const Cell &cell : cells) {
+    for (size_t i = 0; i < cell.counts.size(); i++) {
+      const uint64_t count = cell.counts[i].load(std::memory_order_relaxed);
+      snapshot.counts[i] += count;
+      snapshot.count += count;
+    }
+    sum_ns += cell.sum_ns.load(std::memory_order_relaxed);
+  }
+  snapshot.sum = static_cast<double>(sum_ns) / 1e9;
+  return snapshot;
+}
+
+Metrics &Metrics::instance() {
+  static Metrics metrics;
+  return metrics;
+}
+
+Metrics::Family &Metrics::family(const std::string &name, const std::string &help, Type type) {
+  auto [it, inserted] = families.try_emplace(name);
+  if (inserted) {
+    it->second.help = help;
+    it->second.type = type;
+  }
+  return it->second;
+}
+
+Counter &Metrics::counter(const std::string &name, const std::string &help, const Labels &labels) {
+  const std::string key = renderLabels(labels);
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    if (auto it = families.find(name); it != families.end()) {
+      if (auto series = it->second.counters.find(key); series != it->second.counters.end()) return *series->second;
+    }
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  std::unique_ptr<Counter> &counter = family(name, help, Type::Counter).counters[key];
+  if (!counter) counter = std::make_unique<Counter>();
+  return *counter;
+}
+
+Histogram &Metrics::histogram(const std::string &name, const std::string &help, const Labels &labels) {
+  const std::string key = renderLabels(labels);
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    if (auto it = families.find(name); it != families.end()) {
+      if (auto series = it->second.histograms.find(key); series != it->second.histograms.end()) return *series->second;
+    }
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  std::unique_ptr<Histogram> &histogram = family(name, help, Type::Histogram).histograms[key];
+  if (!histogram) histogram = std::make_unique<Histogram>();
+  return *histogram;
+}
+
+void Metrics::gauge(const std::string &name, const std::string &help, std::function<double()> read, bool monotonic) {
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  family(name, help, monotonic ? Type::Counter : Type::Gauge).read = std::move(read);
+}
+
+void Metrics::record_rest(const std::string &route, unsigned status, std::chrono::nanoseconds duration) {
+  struct RouteSeries {
+    Histogram *latency;
+    std::unordered_map<unsigned, Counter *> requests; // By status
+  };
+  RouteSeries &series = cachedSeries(route, [this, &route]() {
+    return RouteSeries{&histogram("bot_rest_request_seconds", "REST request latency by route", {{"route", route}}), {}};
+  });
+  Counter *&requests = series.requests[status];
+  if (!requests) {
+    requests = &counter("bot_rest_requests_total", "REST requests by route and HTTP status",
+                        {{"route", route}, {"status", std::to_string(status)}});
+  }
+  requests->add();
+  series.latency->observe(duration);
+}
+
+std::string Metrics::render() const {
+  std::ostringstream out;
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  for (const auto &[name, family] : families) {
+    static const char *const TYPES[] = {"counter", "histogram", "gauge"};
+    out << "# HELP " << name << " " << family.help << "\n";
+    out << "# TYPE " << name << " " << TYPES[static_cast<int>(family.type)] << "\n";
+
+    for (const auto &[labels, counter] : family.counters) {
+      out << series(name, labels) << " " << counter->value() << "\n";
+    }
+    for (const auto &[labels, histogram] : family.histograms) {
+      const Histogram::Snapshot snapshot = histogram->snapshot();
+      uint64_t cumulative = 0;
+      for (size_t i = 0; i < Histogram::BOUNDS.size(); i++) {
+        cumulative += snapshot.counts[i];
+        std::ostringstream bound;
+        bound << Histogram::BOUNDS[i];
+        out << series(name + "_bucket", labels, "le=\"" + bound.str() + "\"") << " " << cumulative << "\n";
+      }
+      out << series(name + "_bucket", labels, "le=\"+Inf\"") << " " << snapshot.count << "\n";
+      out << series(name + "_sum", labels) << " " << snapshot.sum << "\n";
+      out << series(name + "_count", labels) << " " << snapshot.count << "\n";
+    }
+    if (family.read) {
+      out << name << " " << family.read() << "\n";
+    }
+  }
+  return out.str();
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Counters and histograms are split into per-CPU cells, so threads on different cores never share a cache line
+constexpr size_t METRIC_SHARDS = 16; // Power of two
+
+// Monotonic count, summed over all cells when scraped
+class Counter {
+public:
+  void add(uint64_t n = 1);
+  uint64_t value() const;
+
+private:
+  struct alignas(64) Cell {
+    std::atomic<uint64_t> value{0};
+  };
+  std::array<Cell, METRIC_SHARDS> cells;
+};
+
+// Latency distribution over fixed buckets from 100 µs to 10 s
+class Histogram {
+public:
+  static constexpr std::array<double, 14> BOUNDS = {0.0001, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+                                                    0.05,   0.1,    0.25,  0.5,    1,     2.5,  10};
+
+  void observe(std::chrono::nanoseconds duration);
+
+  struct Snapshot {
+    std::array<uint64_t, BOUNDS.size() + 1> counts; // Per bucket, not cumulative, last is +Inf
+    double sum;                                     // Seconds
+    uint64_t count;
+  };
+  Snapshot snapshot() const;
+
+private:
+  struct alignas(64) Cell {
+    std::array<std::atomic<uint64_t>, BOUNDS.size() + 1> counts{};
+    std::atomic<uint64_t> sum_ns{0};
+  };
+  std::array<Cell, METRIC_SHARDS> cells;
+};
+
+// Observes the time from construction, or an earlier `start`, to destruction, also across co_await
+class ScopedTimer {
+public:
+  explicit ScopedTimer(Histogram &histogram, std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now())
+      : histogram(histogram), start(start) {}
+  ~ScopedTimer() { histogram.observe(std::chrono::steady_clock::now() - start); }
+
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+  Histogram &histogram;
+  const std::chrono::steady_clock::time_point start;
+};
+
+// Lock `mutex`, observing how long it took to get it
+inline std::unique_lock<std::mutex> lockTimed(std::mutex &mutex, Histogram &wait) {
+  std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+  if (lock.owns_lock()) {
+    wait.observe(std::chrono::nanoseconds(0)); // Uncontended, skip the clock
+    return lock;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  lock.lock();
+  wait.observe(std::chrono::steady_clock::now() - start);
+  return lock;
+}
+
+// Process-wide registry rendered in the Prometheus text format
+// Metrics live as long as the process, so hot paths can keep references to them
+class Metrics {
+public:
+  using Labels = std::vector<std::pair<std::string, std::string>>;
+
+  static Metrics &instance();
+
+  Counter &counter(const std::string &name, const std::string &help, const Labels &labels = {});
+  Histogram &histogram(const std::string &name, const std::string &help, const Labels &labels = {});
+
+  // Value read when scraped, for state another component already tracks, exposed as a counter if monotonic
+  void gauge(const std::string &name, const std::string &help, std::function<double()> read, bool monotonic = false);
+
+  // REST request to `route` that took `duration` and got `status`, 0 if it never got a response
+  void record_rest(const std::string &route, unsigned status, std::chrono::nanoseconds duration);
+
+  std::string render() const;
+
+private:
+  enum class Type { Counter, Histogram, Gauge };
+
+  struct Family {
+    std::string help;
+    Type type;
+    std::map<std::string, std::unique_ptr<Counter>> counters; // By rendered label set
+    std::map<std::string, std::unique_ptr<Histogram>> histograms;
+    std::function<double()> read;
+  };
+
+  Metrics() = default;
+  Family &family(const std::string &name, const std::string &help, Type type); // Caller holds mutex exclusively
+
+  mutable std::shared_mutex mutex; // Lookups of existing series only take it shared
+  std::map<std::string, Family> families;
+};
+
+// Series for `key` on a hot path, made by `resolve` the first time each thread asks for it
+// Registry lookups take its lock and format labels, so later calls only hash the key. Each call site has its own cache,
+// as the lambda passed for `resolve` has a type of its own
+template <typename Key, typename Resolve> auto &cachedSeries(const Key &key, Resolve resolve) {
+  thread_local std::unordered_map<Key, std::invoke_result_t<Resolve &>> cache;
+  auto it = cache.find(key);
+  if (it == cache.end()) it = cache.emplace(key, resolve()).first;
+  return it->second;
+}
@@ -0,0 +1,77 @@
+#include "metrics_server.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include <memory>
+#include <string>
+
+namespace {
+
+using boost::asio::ip::tcp;
+
+// One request per connection, answered and closed
+class Session : public std::enable_shared_from_this<Session> {
+public:
+  explicit Session(tcp::socket socket) : socket(std::move(socket)) {}
+
+  void start() {
+    auto self = shared_from_this();
+    boost::asio::async_read_until(socket, boost::asio::dynamic_buffer(request, 8192), "\r\n\r\n",
+                                  [self](const boost::system::error_code &ec, size_t) {
+                                    if (!ec) self->respond();
+                                  });
+  }
+
+private:
+  void respond() {
+    const bool metrics = request.rfind("GET /metrics ", 0) == 0 || request.rfind("GET / ", 0) == 0;
+    const std::string body = metrics ? Metrics::instance().render() : "Not Found\n";
+    response = std::string(metrics ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 404 Not Found\r\n") +
+               "Content-Type: text/plain; version=0.0.4\r\n"
+               "Content-Length: " + std::to_string(body.size()) + "\r\n"
+               "Connection: close\r\n\r\n" + body;
+
+    auto self = shared_from_this();
+    boost::asio::async_write(socket, boost::asio::buffer(response), [self](const boost::system::error_code &, size_t) {
+      boost::system::error_code ignored;
+      self->socket.shutdown(tcp::socket::shutdown_both, ignored);
+    });
+  }
+
+  tcp::socket socket;
+  std::string request;
+  std::string response;
+};
+
+} // namespace
+
+MetricsServer::MetricsServer(uint16_t port) {
+  if (port == 0) return;
+
+  // Only reachable from this machine, the metrics aren't meant to be public
+  boost::system::error_code ec;
+  const tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), port);
+  acceptor.open(endpoint.protocol(), ec);
+  if (!ec) acceptor.set_option(tcp::acceptor::reuse_address(true), ec);
+  if (!ec) acceptor.bind(endpoint, ec);
+  if (!ec) acceptor.listen(boost::asio::socket_base::max_listen_connections, ec);
+  if (ec) {
+    LOG_ERROR("Failed to serve metrics on port " << port << ": " << ec.message());
+    return;
+  }
+
+  LOG_INFO("Serving metrics on http://127.0.0.1:" << port << "/metrics");
+  accept();
+  thread = std::thread([this]() { io.run(); });
+}
+
+MetricsServer::~MetricsServer() {
+  io.stop();
+  if (thread.joinable()) thread.join();
+}
+
+void MetricsServer::accept() {
+  acceptor.async_accept([this](const boost::system::error_code &ec, tcp::socket socket) {
+    if (!ec) std::make_shared<Session>(std::move(socket))->start();
+    if (acceptor.is_open()) accept();
+  });
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <utility> // Before asio, Boost 1.74 uses std::exchange without including it
+#include <boost/asio.hpp>
+#include <cstdint>
+#include <thread>
+
+// Serves Metrics::render() as Prometheus text on 127.0.0.1, GET /metrics
+class MetricsServer {
+public:
+  // Port 0 disables the server
+  explicit MetricsServer(uint16_t port);
+  ~MetricsServer();
+
+  MetricsServer(const MetricsServer &) = delete;
+  MetricsServer &operator=(const MetricsServer &) = delete;
+
+private:
+  void accept();
+
+  boost::asio::io_context io;
+  boost::asio::ip::tcp::acceptor acceptor{io};
+  std::thread thread;
+};
@@ -0,0 +1,123 @@
+#include "outbound_queue.hpp"
+#include "logger.hpp"
+#include "timed_rest.hpp"
+
+void OutboundQueue::send(dpp::message message, dpp::command_completion_event_t callback) {
+  const dpp::snowflake channel_id = message.channel_id;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    channels[channel_id].queue.push_back({std::move(message), std::move(callback), nullptr, 0});
+  }
+  pump(channel_id);
+}
+
+void OutboundQueue::send_chain(dpp::message first, std::vector<std::string> contents) {
+  if (contents.empty()) return;
+  const dpp::snowflake channel_id = first.channel_id;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    channels[channel_id].queue.push_back(
+        {std::move(first), {}, std::make_shared<const std::vector<std::string>>(std::move(contents)), 0});
+  }
+  pump(channel_id);
+}
+
+void OutboundQueue::pump(dpp::snowflake channel_id) {
+  std::vector<Pending> batch;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = channels.find(channel_id);
+    if (it == channels.end()) return;
+    Channel &channel = it->second;
+
+    // Issue as many requests as the bucket has tokens, in queue order
+    while (!channel.chain_in_flight && !channel.waiting && !channel.queue.empty()) {
+      // Out of tokens, try again when the bucket resets
+      const Scheduler::Clock::time_point now = Scheduler::Clock::now();
+      if (channel.remaining <= 0 && now < channel.reset) {
+        if (channel.in_flight > 0) break; // Their responses refresh the bucket
+        channel.waiting = true;
+        scheduler.schedule_at(channel.reset, [this, channel_id]() {
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = channels.find(channel_id);
+            if (it == channels.end()) return;
+            it->second.waiting = false;
+            it->second.remaining = 1;
+          }
+          pump(channel_id);
+        });
+        break;
+      }
+      if (channel.remaining <= 0) channel.remaining = 1; // The bucket has reset since the last response
+
+      batch.push_back(std::move(channel.queue.front()));
+      channel.queue.pop_front();
+      channel.in_flight++;
+      channel.remaining--;
+      channel.chain_in_flight = batch.back().chain != nullptr;
+    }
+  }
+
+  for (Pending &pending : batch) {
+    issue(channel_id, std::move(pending));
+  }
+}
+
+void OutboundQueue::issue(dpp::snowflake channel_id, Pending pending) {
+  // A chain link keeps its message to build the next link from, any other message is moved, files and all
+  dpp::message message;
+  if (pending.chain) {
+    message = pending.message;
+    message.set_content((*pending.chain)[pending.link]);
+  } else {
+    message = std::move(pending.message);
+  }
+  auto done = [this, channel_id, pending = std::move(pending)](const dpp::confirmation_callback_t &result) {
+    completed(channel_id, result, pending);
+    if (pending.callback) pending.callback(result);
+    pump(channel_id);
+  };
+  bot.message_create(message, timedCallback("message_create", std::move(done)));
+}
+
+void OutboundQueue::completed(dpp::snowflake channel_id, const dpp::confirmation_callback_t &result,
+                              const Pending &pending) {
+  const auto &headers = result.http_info.headers;
+  const auto remaining = headers.find("x-ratelimit-remaining");
+  const auto reset_after = headers.find("x-ratelimit-reset-after");
+
+  std::lock_guard<std::mutex> lock(mutex);
+  Channel &channel = channels[channel_id];
+  channel.in_flight--;
+  try {
+    if (remaining != headers.end() && reset_after != headers.end()) {
+      // Requests still in flight were counted before this response, they use up tokens it reports as left
+      channel.remaining = std::stol(remaining->second) - static_cast<long>(channel.in_flight);
+      channel.reset = Scheduler::Clock::now() + std::chrono::duration_cast<Scheduler::Clock::duration>(
+                                                    std::chrono::duration<double>(std::stod(reset_after->second)));
+    } else {
+      channel.remaining = 1;
+    }
+  } catch (const std::exception &) {
+    channel.remaining = 1; // Malformed headers, fall back to one request at a time
+  }
+
+  // The next link of a chain takes the head of the queue before the channel is pumped again, replying to this one
+  if (pending.chain) {
+    channel.chain_in_flight = false;
+    if (result.is_error()) {
+      LOG_ERROR("Chained message failed: " << result.get_error().message);
+    } else if (pending.link + 1 < pending.chain->size()) {
+      dpp::message message = pending.message;
+      message.set_reference(result.get<dpp::message>().id);
+      channel.queue.push_front({std::move(message), {}, pending.chain, pending.link + 1});
+    }
+  }
+
+  // Forget idle channels once their bucket has refilled
+  if (channel.queue.empty() && channel.in_flight == 0 && !channel.waiting &&
+      (channel.remaining > 0 || Scheduler::Clock::now() >= channel.reset)) {
+    channels.erase(channel_id);
+  }
+}
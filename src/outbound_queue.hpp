@@ -0,0 +1,52 @@
+#pragma once
+
+#include "scheduler.hpp"
+#include <deque>
+#include <dpp/dpp.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Sends messages per channel in the order they were queued, as many at once as the channel's rate limit bucket
+// Discord reports has tokens for
+class OutboundQueue {
+public:
+  OutboundQueue(dpp::cluster &bot, Scheduler &scheduler) : bot(bot), scheduler(scheduler) {}
+
+  // Queue a message for its channel, the callback runs once Discord has answered
+  void send(dpp::message message, dpp::command_completion_event_t callback = {});
+
+  // Send each content in turn, every message replying to the one sent before it
+  // Nothing else queued for the channel goes out between two messages of the chain
+  void send_chain(dpp::message first, std::vector<std::string> contents);
+
+private:
+  struct Pending {
+    dpp::message message;
+    dpp::command_completion_event_t callback;
+    std::shared_ptr<const std::vector<std::string>> chain; // Contents of a chain, this is link `link` of it
+    size_t link = 0;
+  };
+
+  // Token bucket mirrored from the X-RateLimit headers of the last response
+  struct Channel {
+    std::deque<Pending> queue;
+    size_t in_flight = 0;
+    bool chain_in_flight = false; // A chain link is in flight, its next link goes before anything else
+    bool waiting = false;         // A pump is scheduled for when the bucket resets
+    long remaining = 1;           // Unknown until the first response, allow one request
+    Scheduler::Clock::time_point reset;
+  };
+
+  void pump(dpp::snowflake channel_id);
+  void issue(dpp::snowflake channel_id, Pending pending);
+  void completed(dpp::snowflake channel_id, const dpp::confirmation_callback_t &result, const Pending &pending);
+
+  dpp::cluster &bot;
+  Scheduler &scheduler;
+
+  std::mutex mutex;
+  std::unordered_map<dpp::snowflake, Channel> channels;
+};
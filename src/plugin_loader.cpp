@@ -0,0 +1,181 @@
+#include "plugin_loader.hpp"
+#include "command_sync.hpp"
+#include "commands/command.hpp"
+#include "logger.hpp"
+#include <dlfcn.h>
+#include <filesystem>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// How long a replaced plugin version stays mapped after it is deleted
+constexpr std::chrono::seconds UNLOAD_DELAY{1};
+
+// Plugin name from its filename, empty if it isn't a plugin
+std::string pluginName(const std::string &filename) {
+  if (filename.size() <= 3 || filename.compare(filename.size() - 3, 3, ".so") != 0) return "";
+  std::string name = filename.substr(0, filename.size() - 3);
+  if (name.rfind("lib", 0) == 0) {
+    name = name.substr(3);
+  }
+  return name;
+}
+
+// Created before the watch is added, so the watcher has something to watch
+const std::string &createDirectory(const std::string &directory) {
+  std::error_code ec;
+  fs::create_directories(directory, ec);
+  return directory;
+}
+
+} // namespace
+
+PluginLoader::PluginLoader(custom_cluster &bot, std::string directory)
+    : bot(bot), directory(std::move(directory)), builtin(*bot.get_commands()),
+      watcher(createDirectory(this->directory), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) {
+  if (!watcher.is_watching()) {
+    LOG_ERROR("Failed to watch " << this->directory << ", plugins won't be reloaded");
+  }
+
+  // Load what is already there, changes from now on are queued by the watch and handled once it starts
+  std::error_code ec;
+  for (const auto &entry : fs::directory_iterator(this->directory, ec)) {
+    load(entry.path().filename().string());
+  }
+
+  watcher.start([this](const std::string &filename, uint32_t mask) {
+    if (mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+      load(filename);
+    } else {
+      unload(filename);
+    }
+  });
+}
+
+void PluginLoader::load(const std::string &filename) {
+  const std::string name = pluginName(filename);
+  if (name.empty()) return;
+
+  // dlopen returns the already loaded library for a path it has seen, so open a private copy
+  char copy[] = "/tmp/brain-damage-plugin-XXXXXX";
+  const int fd = mkstemp(copy);
+  if (fd < 0) return;
+  close(fd);
+  std::error_code ec;
+  fs::copy_file(fs::path(directory) / filename, copy, fs::copy_options::overwrite_existing, ec);
+  void *handle = ec ? nullptr : dlopen(copy, RTLD_NOW | RTLD_LOCAL);
+  unlink(copy); // The mapping stays valid
+  if (!handle) {
+    LOG_ERROR("Failed to load plugin " << filename << ": " << (ec ? ec.message() : dlerror()));
+    return;
+  }
+
+  using Factory = Command *(*)();
+  const std::string symbol = "create_" + name + "_command";
+  auto factory = reinterpret_cast<Factory>(dlsym(handle, symbol.c_str()));
+  Command *raw = factory ? factory() : nullptr;
+  if (!raw) {
+    LOG_ERROR("Plugin " << filename << " doesn't export " << symbol);
+    dlclose(handle);
+    return;
+  }
+
+  // A version is deleted once nothing holds it: the command table has moved on, every runCommand running it has
+  // returned and no callback it left behind holds shared_from_this(). The library is closed a little later, so a
+  // callback whose destructor dropped the last reference has left the plugin's code by then
+  custom_cluster &bot = this->bot;
+  std::shared_ptr<Command> command(raw, [&bot, handle, filename](Command *command) {
+    delete command;
+    bot.scheduler.schedule(UNLOAD_DELAY, [handle, filename]() {
+      dlclose(handle);
+      LOG_DEBUG("Unloaded a replaced version of plugin " + filename);
+    });
+  });
+
+  LOG_DEBUG("Loaded plugin " + filename + " providing /" + command->get_name());
+  std::string command_name = command->get_name();
+  update(filename, Plugin{std::move(command_name), std::move(command), 0});
+}
+
+void PluginLoader::unload(const std::string &filename) {
+  LOG_DEBUG("Removed plugin " + filename);
+  update(filename, std::nullopt);
+}
+
+void PluginLoader::update(const std::string &filename, std::optional<Plugin> plugin) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> names;
+    auto it = plugins.find(filename);
+    if (it != plugins.end()) {
+      names.push_back(it->second.name);
+      plugins.erase(it);
+    }
+    if (plugin) {
+      plugin->loaded = ++loads;
+      names.push_back(plugin->name);
+      plugins.emplace(filename, std::move(*plugin));
+    }
+    if (names.empty()) return;
+
+    // One new table for the whole change, so a rename publishes both names at once
+    auto table = std::make_shared<custom_cluster::CommandTable>(*bot.get_commands());
+    for (const std::string &name : names) {
+      if (std::shared_ptr<Command> command = provider(name)) {
+        (*table)[name] = std::move(command);
+      } else {
+        table->erase(name);
+      }
+    }
+    bot.set_commands(std::move(table));
+  }
+  resync();
+}
+
+std::shared_ptr<Command> PluginLoader::provider(const std::string &name) const {
+  // The most recently loaded plugin providing a name wins, then the built-in command of that name
+  const Plugin *latest = nullptr;
+  for (const auto &[filename, plugin] : plugins) {
+    if (plugin.name == name && (!latest || plugin.loaded > latest->loaded)) {
+      latest = &plugin;
+    }
+  }
+  if (latest) return latest->command;
+  auto it = builtin.find(name);
+  return it != builtin.end() ? it->second : nullptr;
+}
+
+dpp::job PluginLoader::resync() {
+  // One sync at a time, changes made while it runs are picked up by another pass
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (syncing) {
+      sync_again = true;
+      co_return;
+    }
+    syncing = true;
+  }
+
+  while (true) {
+    // ReadyEvent syncs the table if we aren't connected yet
+    if (!bot.me.id.empty()) {
+      try {
+        co_await syncSlashCommands(bot, bot.get_config()->guild_id, slashCommandDefinitions(bot));
+      } catch (const std::exception &e) {
+        LOG_ERROR("Failed to sync slash commands after plugin change: " << e.what());
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!sync_again) {
+      syncing = false;
+      co_return;
+    }
+    sync_again = false;
+  }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "directory_watcher.hpp"
+#include "main.hpp"
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// Loads command plugins from shared libraries and hot-swaps them into the bot's command table
+//
+// A plugin named <name>.so (or lib<name>.so) exports `Command *create_<name>_command()`. Updated
+// files replace the loaded version, removed files restore the next plugin or built-in command of that name if any.
+// Replaced versions stop receiving new executions and are unloaded once the executions already running have finished.
+class PluginLoader {
+public:
+  PluginLoader(custom_cluster &bot, std::string directory = "commands");
+
+  PluginLoader(const PluginLoader &) = delete;
+  PluginLoader &operator=(const PluginLoader &) = delete;
+
+private:
+  struct Plugin {
+    std::string name; // Command it provides
+    std::shared_ptr<Command> command;
+    uint64_t loaded; // Load order, the latest plugin for a name wins
+  };
+
+  void load(const std::string &filename);
+  void unload(const std::string &filename);
+  void update(const std::string &filename, std::optional<Plugin> plugin); // Swap the file's plugin and publish
+  std::shared_ptr<Command> provider(const std::string &name) const;       // Caller holds mutex
+  dpp::job resync();
+
+  custom_cluster &bot;
+  const std::string directory;
+
+  std::mutex mutex;
+  custom_cluster::CommandTable builtin;            // Statically linked commands, restored on unload
+  std::unordered_map<std::string, Plugin> plugins; // By filename
+  uint64_t loads = 0;
+  bool syncing = false;    // A slash command sync is running
+  bool sync_again = false; // The table changed while it ran
+
+  DirectoryWatcher watcher; // Last, so it stops before the state it loads into goes away
+};
@@ -0,0 +1,160 @@
+#include "process_runner.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+extern char **environ;
+
+ProcessRunner::ProcessRunner(size_t max_jobs, std::chrono::milliseconds update_interval)
+    : max_jobs(std::max<size_t>(1, max_jobs)), update_interval(update_interval) {}
+
+ProcessRunner::~ProcessRunner() { wait(); }
+
+void ProcessRunner::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  idle.wait(lock, [this]() { return active == 0; });
+}
+
+void ProcessRunner::submit(std::function<void()> job) {
+  std::lock_guard<std::mutex> lock(mutex);
+  active++;
+  queue.push_back(std::move(job));
+  if (workers < max_jobs) {
+    workers++;
+    std::thread([this]() { work(); }).detach();
+  }
+}
+
+void ProcessRunner::work() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!queue.empty()) {
+    std::function<void()> job = std::move(queue.front());
+    queue.pop_front();
+    lock.unlock();
+    try {
+      job();
+    } catch (const std::exception &e) {
+      LOG_ERROR("Unhandled exception in process job: " << e.what());
+    }
+    job = nullptr; // Release what the job captured before wait() can return
+    lock.lock();
+    active--;
+  }
+  // Leaving in the same critical section as the last active-- keeps wait() from returning while this thread still
+  // needs the runner
+  workers--;
+  idle.notify_all();
+}
+
+ProcessRunner::Result ProcessRunner::run(const std::string &command, const Limits &limits,
+                                         const OutputCallback &on_output) const {
+  Result result;
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) != 0) {
+    result.output = "Failed to execute command.";
+    return result;
+  }
+
+  // The shell applies the rlimits to itself before running the command, posix_spawn can't set them directly
+  // A limit the shell can't set fails the command instead of running it without the limit
+  std::string prelude;
+  if (limits.cpu_seconds > 0) prelude += "ulimit -t " + std::to_string(limits.cpu_seconds) + " || exit 126; ";
+  if (limits.memory_kb > 0) prelude += "ulimit -v " + std::to_string(limits.memory_kb) + " || exit 126; ";
+  if (limits.processes > 0) {
+    // bash calls it -u, dash -p
+    const std::string count = std::to_string(limits.processes);
+    prelude += "{ ulimit -u " + count + " || ulimit -p " + count + "; } 2>/dev/null || exit 126; ";
+  }
+  const std::string script = prelude + "eval \"$1\"";
+  const char *argv[] = {"/bin/sh", "-c", script.c_str(), "sh", command.c_str(), nullptr};
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, fds[1], STDERR_FILENO);
+  posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+
+  // Own process group, so a timeout kills everything the command started
+  posix_spawnattr_t attr;
+  posix_spawnattr_init(&attr);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+  posix_spawnattr_setpgroup(&attr, 0);
+
+  pid_t pid;
+  const int spawned = posix_spawn(&pid, "/bin/sh", &actions, &attr, const_cast<char *const *>(argv), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+  close(fds[1]);
+  if (spawned != 0) {
+    close(fds[0]);
+    result.output = "Failed to execute command.";
+    return result;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  const Clock::time_point deadline = Clock::now() + limits.timeout;
+  Clock::time_point last_update = Clock::now();
+  size_t reported = 0;
+  std::array<char, 4096> buffer;
+
+  while (true) {
+    const Clock::time_point now = Clock::now();
+    if (now >= deadline) {
+      kill(-pid, SIGKILL);
+      result.timed_out = true;
+      break;
+    }
+
+    // Wake for output, the deadline, or the next progress update
+    Clock::time_point wake = deadline;
+    if (on_output && result.output.size() != reported) wake = std::min(wake, last_update + update_interval);
+    const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(wake - now).count();
+    pollfd pfd{fds[0], POLLIN, 0};
+    const int ready = poll(&pfd, 1, static_cast<int>(std::max<long long>(0, wait)));
+    if (ready < 0 && errno != EINTR) break;
+
+    if (ready > 0) {
+      const ssize_t n = read(fds[0], buffer.data(), buffer.size());
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) break; // EOF, every writer has exited
+
+      const size_t room = limits.max_output - std::min(limits.max_output, result.output.size());
+      result.output.append(buffer.data(), std::min(room, static_cast<size_t>(n)));
+      result.truncated |= static_cast<size_t>(n) > room;
+    }
+
+    if (on_output && result.output.size() != reported && Clock::now() - last_update >= update_interval) {
+      on_output(result.output);
+      reported = result.output.size();
+      last_update = Clock::now();
+    }
+  }
+  close(fds[0]);
+
+  // A command can close its output and keep running, the deadline still applies until it exits
+  int status = 0;
+  while (!result.timed_out) {
+    const pid_t waited = waitpid(pid, &status, WNOHANG);
+    if (waited == pid || (waited < 0 && errno != EINTR)) break;
+    if (Clock::now() >= deadline) {
+      kill(-pid, SIGKILL);
+      result.timed_out = true;
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  if (result.timed_out) {
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+  }
+  if (WIFEXITED(status)) result.exit_code = WEXITSTATUS(status);
+  return result;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+// Runs shell commands through posix_spawn, streaming their output and enforcing time, output and rlimit caps
+class ProcessRunner {
+public:
+  struct Limits {
+    std::chrono::seconds timeout;  // Whole process group is killed after this
+    size_t max_output;             // Bytes kept, the rest is read and discarded
+    unsigned long cpu_seconds = 0; // RLIMIT_CPU, 0 for none
+    unsigned long memory_kb = 0;   // RLIMIT_AS, 0 for none
+    unsigned long processes = 0;   // RLIMIT_NPROC, 0 for none. Counts every process and thread of the bot's user
+  };
+
+  struct Result {
+    int exit_code = -1; // -1 if killed by a signal or never started
+    bool timed_out = false;
+    bool truncated = false;
+    std::string output; // stdout and stderr interleaved
+  };
+
+  // Called with everything captured so far, at most once per update interval
+  using OutputCallback = std::function<void(const std::string &output)>;
+
+  explicit ProcessRunner(size_t max_jobs = 4, std::chrono::milliseconds update_interval = std::chrono::milliseconds(1500));
+  ~ProcessRunner();
+
+  ProcessRunner(const ProcessRunner &) = delete;
+  ProcessRunner &operator=(const ProcessRunner &) = delete;
+
+  // Run a command on the calling thread
+  Result run(const std::string &command, const Limits &limits, const OutputCallback &on_output = {}) const;
+
+  // Queue a job, at most max_jobs threads run queued jobs at a time and exit once the queue is empty
+  void submit(std::function<void()> job);
+
+  // Block until every submitted job has finished
+  void wait();
+
+private:
+  void work();
+
+  const size_t max_jobs;
+  const std::chrono::milliseconds update_interval;
+
+  std::mutex mutex;
+  std::condition_variable idle;
+  std::deque<std::function<void()>> queue;
+  size_t workers = 0; // Threads draining the queue
+  size_t active = 0;  // Submitted jobs that haven't finished, waited for on destruction
+};
@@ -0,0 +1,81 @@
+#include "scheduler.hpp"
+#include "logger.hpp"
+
+Scheduler::Scheduler() : thread([this]() { run(); }) {}
+
+Scheduler::~Scheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  thread.join();
+}
+
+Scheduler::Handle Scheduler::schedule_at(Clock::time_point when, Task task) {
+  std::lock_guard<std::mutex> lock(mutex);
+  const Handle handle = next_handle++;
+  tasks.emplace(handle, std::move(task));
+  const bool earliest = deadlines.empty() || when < deadlines.top().when;
+  deadlines.push({when, handle});
+  if (earliest) {
+    wake.notify_one();
+  }
+  return handle;
+}
+
+bool Scheduler::cancel(Handle handle) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (tasks.erase(handle) == 0) return false;
+  compact();
+  return true;
+}
+
+size_t Scheduler::pending() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return tasks.size();
+}
+
+void Scheduler::compact() {
+  // Rebuild the heap once cancelled deadlines outnumber live ones, so memory tracks live tasks only
+  if (deadlines.size() < 64 || deadlines.size() < tasks.size() * 2) return;
+  std::vector<Deadline> live;
+  live.reserve(tasks.size());
+  while (!deadlines.empty()) {
+    if (tasks.contains(deadlines.top().handle)) {
+      live.push_back(deadlines.top());
+    }
+    deadlines.pop();
+  }
+  deadlines = decltype(deadlines)(std::greater<Deadline>(), std::move(live));
+}
+
+void Scheduler::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!stopping) {
+    if (deadlines.empty()) {
+      wake.wait(lock);
+      continue;
+    }
+
+    const Deadline next = deadlines.top();
+    if (Clock::now() < next.when) {
+      wake.wait_until(lock, next.when);
+      continue;
+    }
+    deadlines.pop();
+
+    auto it = tasks.find(next.handle);
+    if (it == tasks.end()) continue; // Cancelled
+    Task task = std::move(it->second);
+    tasks.erase(it);
+
+    lock.unlock();
+    try {
+      task();
+    } catch (const std::exception &e) {
+      LOG_ERROR("Unhandled exception in scheduled task: " << e.what());
+    }
+    lock.lock();
+  }
+}
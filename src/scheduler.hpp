@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Single thread running delayed tasks from a min-heap of deadlines
+// Tasks run on the scheduler thread, anything slow should be handed to the executor
+class Scheduler {
+public:
+  using Clock = std::chrono::steady_clock;
+  using Task = std::function<void()>;
+  using Handle = uint64_t; // 0 is never a valid handle
+
+  Scheduler();
+  ~Scheduler();
+
+  Scheduler(const Scheduler &) = delete;
+  Scheduler &operator=(const Scheduler &) = delete;
+
+  Handle schedule(Clock::duration delay, Task task) { return schedule_at(Clock::now() + delay, std::move(task)); }
+  Handle schedule_at(Clock::time_point when, Task task);
+
+  // Returns false if the task already ran or was cancelled
+  bool cancel(Handle handle);
+
+  size_t pending();
+
+private:
+  struct Deadline {
+    Clock::time_point when;
+    Handle handle;
+    bool operator>(const Deadline &other) const { return when > other.when; }
+  };
+
+  void run();
+  void compact(); // Caller holds mutex
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines;
+  std::unordered_map<Handle, Task> tasks; // Cancelled tasks are erased here and skipped in the heap
+  Handle next_handle = 1;
+  bool stopping = false;
+  std::thread thread;
+};
@@ -1,77 +1,25 @@
-#define VERBOSE_DEBUG
-
 #include "starboard.hpp"
+#include "logger.hpp"
+#include "timed_rest.hpp"
 #include <chrono>
-#include <iostream>
 #include <sstream>
 #include <thread>
 #include <vector>
 #include <algorithm>
+#include <utility>
 #include <dpp/dpp.h>
 
-#ifdef VERBOSE_DEBUG
-#define LOG_DEBUG(msg) std::cout << "[DEBUG] " << msg << std::endl
-#else
-#define LOG_DEBUG(msg)
-#endif
+// Stars needed before a message is posted to the starboard
+constexpr int STAR_THRESHOLD = 2;
 
-template <typename EventType>
-void updateStarboardMessage(custom_cluster &bot, const EventType &event) {
-  LOG_DEBUG("Attempting to lock starboard mutex");
-  std::unique_lock<std::mutex> lock(bot.starboard_mutex, std::defer_lock);
-
-  // If the mutex is already locked, wait for it to unlock
-  if (!lock.try_lock()) {
-    LOG_DEBUG("Starboard mutex is locked, waiting...");
-    auto start = std::chrono::high_resolution_clock::now();
-    lock.lock();
-    auto stop = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
-    LOG_DEBUG("Starboard mutex acquired after " + std::to_string(duration.count()) + "ms");
-  } else {
-    LOG_DEBUG("Starboard mutex acquired immediately");
-  }
+// How long a posted message may go on incremental counts before it is fetched again
+constexpr auto STAR_RESYNC_INTERVAL = std::chrono::minutes(10);
 
-  LOG_DEBUG("Fetching message details");
-  // Get the message, channel, and star count
-  const dpp::message msg = bot.message_get_sync(event.message_id, event.channel_id);
-  const auto starCountIt = std::find_if(msg.reactions.begin(), msg.reactions.end(),
-                                        [](const dpp::reaction &r) { return r.emoji_name == "⭐"; });
-  const int starCount = starCountIt != msg.reactions.end() ? starCountIt->count : 0;
-  const dpp::channel channel = bot.channel_get_sync(event.channel_id);
-  const long timestamp = msg.get_creation_time();
-
-  // Check if the message is already in the starboard
-  auto &starboard = bot.starboard;
-  const bool starboarded = starboard.find(msg.get_url()) != starboard.end();
-
-  // If the message has less than 2 stars and a reaction has been removed, remove it from the starboard
-  if (starCount < 2) {
-    if (starboarded && std::is_same_v<EventType, dpp::message_reaction_remove_t>) {
-      LOG_DEBUG("Removing message from starboard");
-      bot.message_delete(starboard[msg.get_url()].id, starboard[msg.get_url()].channel_id);
-      starboard.erase(msg.get_url());
-      auto thread_it = bot.starboard_threads.find(msg.get_url());
-      if (thread_it != bot.starboard_threads.end()) {
-        bot.starboard_threads.erase(msg.get_url());
-      }
-    }
-    return;
-  }
-
-  LOG_DEBUG("Creating embed message");
-  // Create the embed message
+dpp::embed buildStarboardEmbed(const dpp::message &msg, const dpp::message &ref) {
   dpp::embed e;
   e.set_author(msg.author.username, msg.author.get_url(), msg.author.get_avatar_url());
   e.set_color(dpp::colors::yellow);
-  e.set_timestamp(timestamp);
-
-  // Get the referenced message
-  const dpp::message::message_ref reference = msg.message_reference;
-  dpp::message ref;
-  if (!reference.message_id.empty()) {
-    ref = bot.message_get_sync(reference.message_id, event.channel_id);
-  }
+  e.set_timestamp(msg.get_creation_time());
 
   // Format the referenced message content
   std::string refcontent = ref.content;
@@ -101,53 +49,213 @@ void updateStarboardMessage(custom_cluster &bot, const EventType &event) {
       e.add_field("Attachment", a.url);
     }
   }
+  return e;
+}
+
+std::string starboardContent(int starCount, const std::string &channelName, const std::string &url) {
+  return "⭐ **" + std::to_string(starCount) + "** | [`# " + channelName + "`](<" + url + ">)";
+}
+
+namespace {
+
+// Forget the entry 3 days after its first star, deferred to the updater if one is running
+// The shard lock is taken on the executor, in order with the message's updates, not on the scheduler thread
+void scheduleExpiry(custom_cluster &bot, dpp::snowflake id, StarboardEntry &entry) {
+  entry.expiry = bot.scheduler.schedule(std::chrono::hours(24 * 3), [botPtr = &bot, id]() {
+    botPtr->executor.submit(id, [botPtr, id]() {
+      const bool erased = botPtr->starboard.erase_if(id, [](StarboardEntry &entry) {
+        entry.expired = true;
+        return !entry.updating;
+      });
+      LOG_DEBUG(erased ? "Message removed from memory" : "Message will be removed after its update");
+    });
+  });
+}
+
+dpp::job runStarboardUpdate(custom_cluster &bot, dpp::snowflake id, dpp::snowflake channel_id);
+
+// Run the next update pass once the debounce window has collected a burst of reactions
+void scheduleStarboardUpdate(custom_cluster &bot, dpp::snowflake id, dpp::snowflake channel_id) {
+  const std::chrono::milliseconds window = bot.get_config()->starboard_debounce;
+  if (window.count() <= 0) {
+    runStarboardUpdate(bot, id, channel_id);
+    return;
+  }
+  bot.scheduler.schedule(window, [botPtr = &bot, id, channel_id]() {
+    botPtr->executor.submit(id, [botPtr, id, channel_id]() { runStarboardUpdate(*botPtr, id, channel_id); });
+  });
+}
+
+// One update pass, REST calls are awaited without any lock held and reconciled with reactions that raced them
+dpp::job runStarboardUpdate(custom_cluster &bot, dpp::snowflake id, dpp::snowflake channel_id) {
+  int adds = 0;
+  int removes = 0;
+  int stars = 0;
+  bool resync = false;
+  std::string url;
+  std::string channelName;
+  dpp::message post;
+  bot.starboard.with(id, [&](StarboardEntry &entry) {
+    adds = std::exchange(entry.pending_adds, 0);
+    removes = std::exchange(entry.pending_removes, 0);
+    entry.dirty = false;
+    stars = entry.stars;
+    url = entry.url;
+    channelName = entry.channel_name;
+    post = entry.post;
+
+    // Fetch when the count first crosses the threshold, a posted message is due a resync or the last fetch raced
+    const bool crossing = !entry.counted || stars - adds + removes < STAR_THRESHOLD;
+    resync = entry.refetch ||
+             (post.id.empty() ? stars >= STAR_THRESHOLD && crossing
+                              : url.empty() || Scheduler::Clock::now() - entry.synced >= STAR_RESYNC_INTERVAL);
+    entry.refetch = false;
+  });
+  const bool posted = !post.id.empty();
+
+  try {
+    int starCount = stars;
+    if (resync) {
+      LOG_DEBUG("Fetching message details");
+      // Get the message, channel, and star count
+      const dpp::message msg = (co_await timedRest("message_get", bot.co_message_get(id, channel_id))).get<dpp::message>();
+      const auto starCountIt = std::find_if(msg.reactions.begin(), msg.reactions.end(),
+                                            [](const dpp::reaction &r) { return r.emoji_name == "⭐"; });
+      starCount = starCountIt != msg.reactions.end() ? starCountIt->count : 0;
+      url = msg.get_url();
 
-  // Check if the message is starred
-  if (starboarded) {
-    LOG_DEBUG("Editing starboard message");
-    // Edit the starboard message
-    dpp::message &m = starboard[msg.get_url()];
-    m.embeds.at(0) = e;
-    m.set_content("⭐ **" + std::to_string(starCount) + "** | [`# " + channel.name + "`](<" + msg.get_url() + ">)");
-    m = bot.message_edit_sync(m);
-  } else if (starCount == 2 && std::is_same_v<EventType, dpp::message_reaction_add_t>) {
-    LOG_DEBUG("Posting message to starboard channel");
-    // Post in starboard channel
-    const dpp::channel starboard_channel = bot.channel_get_sync(bot.get_config().at("starboardChannel").get<dpp::snowflake>());
-    starboard[msg.get_url()] = bot.message_create_sync(dpp::message("⭐ **" + std::to_string(starCount) + "** | [`# " +
-    channel.name + "`](<" + msg.get_url() + ">)")
-    .add_embed(e)
-    .set_channel_id(starboard_channel.id));
-
-    // Remove the message from ram after 3 days ( thread magic )
-    std::string url = msg.get_url();
-    auto thread = std::make_shared<std::thread>([botPtr = &bot, url]() {
-      LOG_DEBUG("Thread started for message removal after delay");
-      std::this_thread::sleep_for(std::chrono::hours(24 * 3));
-      std::unique_lock<std::mutex> lock(botPtr->starboard_mutex, std::defer_lock);
-      if (!lock.try_lock()) {
-        LOG_DEBUG("Thread: Starboard mutex is locked, waiting...");
-        auto start = std::chrono::high_resolution_clock::now();
-        lock.lock();
-        auto stop = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
-        LOG_DEBUG("Thread: Starboard mutex acquired after " + std::to_string(duration.count()) + "ms");
+      // Channels are usually in the gateway cache
+      const dpp::channel *cached = dpp::find_channel(channel_id);
+      channelName = cached ? cached->name : (co_await timedRest("channel_get", bot.co_channel_get(channel_id))).get<dpp::channel>().name;
+
+      // Get the referenced message
+      dpp::message ref;
+      if (!msg.message_reference.message_id.empty()) {
+        ref = (co_await timedRest("message_get", bot.co_message_get(msg.message_reference.message_id, channel_id))).get<dpp::message>();
       }
-      auto &starboard = botPtr->starboard;
-      if (starboard.find(url) != starboard.end() &&
-           botPtr->starboard_threads.find(url) != botPtr->starboard_threads.end()) {
-        starboard.erase(url);
+
+      LOG_DEBUG("Creating embed message");
+      const dpp::embed e = buildStarboardEmbed(msg, ref);
+      // Posts restored from the store have no embed yet
+      post.embeds.clear();
+      post.add_embed(e);
+    }
+
+    // Only post messages that crossed the threshold through these reactions, not old ones starred again
+    const bool crossed = starCount - adds + removes < STAR_THRESHOLD;
+
+    if (starCount < STAR_THRESHOLD) {
+      // If the message has too few stars and a reaction has been removed, remove it from the starboard
+      if (posted && removes > 0) {
+        LOG_DEBUG("Removing message from starboard");
+        const dpp::confirmation_callback_t deleted =
+            co_await timedRest("message_delete", bot.co_message_delete(post.id, post.channel_id));
+        // Already gone counts as removed, anything else keeps the post so a later pass retries
+        if (deleted.is_error() && deleted.http_info.status != 404) {
+          LOG_ERROR("Failed to remove starboard post: " << deleted.get_error().message);
+        } else {
+          post = dpp::message();
+        }
+      } else if (!posted) {
+        post = dpp::message();
       }
-      botPtr->starboard_threads.erase(url);
-      LOG_DEBUG("Thread: Message url removed from memory");
+    } else if (posted) {
+      LOG_DEBUG("Editing starboard message");
+      post.set_content(starboardContent(starCount, channelName, url));
+      post = (co_await timedRest("message_edit", bot.co_message_edit(post))).get<dpp::message>();
+      bot.starboard.edits_issued++;
+    } else if (resync && adds > 0 && crossed) {
+      LOG_DEBUG("Posting message to starboard channel");
+      post.set_content(starboardContent(starCount, channelName, url));
+      post.set_channel_id(bot.get_config()->starboard_channel);
+      post = (co_await timedRest("message_create", bot.co_message_create(post))).get<dpp::message>();
+      bot.starboard.edits_issued++;
+    } else {
+      post = dpp::message();
+    }
+
+    // Still the only updater for this message, so records reach the store in order
+    if (posted || !post.id.empty()) {
+      bot.starboard.persist(id, post, starCount);
+    }
+
+    // Publish the result, and schedule another pass if reactions came in meanwhile
+    bool again = false;
+    bot.starboard.with(id, [&](StarboardEntry &entry) {
+      if (resync) {
+        // Reactions that arrived during the fetch may or may not be in the fetched count, so take the fetched count
+        // as is and fetch again on the pass they scheduled rather than counting them twice
+        entry.stars = starCount;
+        entry.refetch = entry.pending_adds > 0 || entry.pending_removes > 0;
+        entry.counted = true;
+        entry.synced = Scheduler::Clock::now();
+        entry.url = url;
+        entry.channel_name = channelName;
+      }
+      entry.post = post;
+      again = entry.dirty && !entry.expired;
+      entry.updating = again;
+    });
+    if (again) {
+      scheduleStarboardUpdate(bot, id, channel_id);
+      co_return;
+    }
+  } catch (const std::exception &e) {
+    // Release the entry with the reactions this pass took, so the next reaction retries them
+    LOG_ERROR("Starboard update failed: " << e.what());
+    bot.starboard.with(id, [adds, removes](StarboardEntry &entry) {
+      entry.pending_adds += adds;
+      entry.pending_removes += removes;
+      entry.updating = false;
     });
+  }
+
+  // Drop entries that no longer hold anything worth remembering, with their expiry so it can't fire on a later entry
+  bot.starboard.erase_if(id, [&bot](const StarboardEntry &entry) {
+    const bool drop = !entry.updating && ((entry.post.id.empty() && entry.stars <= 0) || entry.expired);
+    if (drop && !entry.expired) {
+      bot.scheduler.cancel(entry.expiry);
+    }
+    return drop;
+  });
+}
+
+} // namespace
+
+template <typename EventType>
+void updateStarboardMessage(custom_cluster &bot, const EventType &event) {
+  constexpr bool added = std::is_same_v<EventType, dpp::message_reaction_add_t>;
+
+  // Count the reaction, then start an update, fold it into the pending one, or skip REST entirely
+  enum class Action { None, Start, Coalesce };
+  const Action action = bot.starboard.with(event.message_id, [&bot, &event](StarboardEntry &entry) {
+    if (entry.expiry == 0) {
+      scheduleExpiry(bot, event.message_id, entry);
+    }
+    entry.stars = std::max(0, entry.stars + (added ? 1 : -1));
+    (added ? entry.pending_adds : entry.pending_removes)++;
+
+    if (entry.updating) {
+      entry.dirty = true;
+      return Action::Coalesce;
+    }
+    if (entry.post.id.empty() && entry.stars < STAR_THRESHOLD) {
+      // Nothing to post or edit, the incremental count is all that changes
+      entry.pending_adds = entry.pending_removes = 0;
+      return Action::None;
+    }
+    entry.updating = true;
+    return Action::Start;
+  });
 
-    // Store the thread and detach it
-    bot.starboard_threads[msg.get_url()] = thread;
-    thread->detach();
+  if (action == Action::Coalesce) {
+    LOG_DEBUG("Starboard update already pending, coalescing reaction");
+    bot.starboard.edits_suppressed++;
+  } else if (action == Action::Start) {
+    scheduleStarboardUpdate(bot, event.message_id, event.channel_id);
   }
 }
 
 // Explicit template instantiation
 template void updateStarboardMessage<dpp::message_reaction_add_t>(custom_cluster &bot, const dpp::message_reaction_add_t &event);
-template void updateStarboardMessage<dpp::message_reaction_remove_t>(custom_cluster &bot, const dpp::message_reaction_remove_t &event);
\ No newline at end of file
+template void updateStarboardMessage<dpp::message_reaction_remove_t>(custom_cluster &bot, const dpp::message_reaction_remove_t &event);
@@ -1,6 +1,13 @@
 #pragma once
 
 #include "main.hpp"
+#include <string>
 
 template <typename EventType>
-void updateStarboardMessage(custom_cluster &bot, const EventType &event);
\ No newline at end of file
+void updateStarboardMessage(custom_cluster &bot, const EventType &event);
+
+// Embed quoting the starred message and the message it replied to, if any
+dpp::embed buildStarboardEmbed(const dpp::message &msg, const dpp::message &ref);
+
+// Text of a starboard post above its embed
+std::string starboardContent(int starCount, const std::string &channelName, const std::string &url);
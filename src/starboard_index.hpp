@@ -0,0 +1,102 @@
+#pragma once
+
+#include "metrics.hpp"
+#include "scheduler.hpp"
+#include "starboard_store.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <dpp/dpp.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// In-memory state of one starred message
+struct StarboardEntry {
+  int stars = 0;                // Kept up to date from reaction events between fetches
+  bool counted = false;         // stars has been corrected from a fetched message at least once
+  Scheduler::Clock::time_point synced;
+  std::string url;              // Source message link and channel name, cached from the last fetch
+  std::string channel_name;
+  dpp::message post;            // Message in the starboard channel, id is empty while not posted
+  Scheduler::Handle expiry = 0; // Forgets the entry after a few days
+  bool updating = false;        // An update is pending or running REST calls for this message
+  bool dirty = false;           // Reactions arrived while updating, the updater schedules another pass
+  bool expired = false;         // Expiry fired while updating, the updater drops the entry
+  bool refetch = false;         // Reactions raced the last fetch, the next pass fetches again
+  int pending_adds = 0;         // Reactions not yet handled by an update pass
+  int pending_removes = 0;
+};
+
+// Starboard entries sharded by source message id, locks are only held while touching an entry
+// Posted messages are also kept in the store, entries dropped from memory are restored from it
+class StarboardIndex {
+public:
+  struct Stats {
+    uint64_t edits_issued;     // Starboard posts created or edited
+    uint64_t edits_suppressed; // Reactions folded into an update that was already pending
+  };
+
+  // Run `fn` on the entry for `id`, creating it if needed
+  template <typename Fn> auto with(dpp::snowflake id, Fn &&fn) {
+    Shard &shard = shard_for(id);
+    const std::unique_lock<std::mutex> lock = lockTimed(shard.mutex, lock_wait);
+    auto [it, inserted] = shard.entries.try_emplace(id);
+    if (inserted) {
+      restore(id, it->second);
+    }
+    return fn(it->second);
+  }
+
+  // Record a post on disk, or forget it once the post is gone
+  // Called without the shard lock, so disk latency doesn't hold up reactions to other messages on the shard
+  void persist(dpp::snowflake id, const dpp::message &post, int stars) {
+    if (post.id.empty()) {
+      store.erase(id);
+    } else {
+      store.put(id, post.id, post.channel_id, stars);
+    }
+  }
+
+  // Drop the entry for `id` if `pred` returns true for it
+  template <typename Pred> bool erase_if(dpp::snowflake id, Pred &&pred) {
+    Shard &shard = shard_for(id);
+    const std::unique_lock<std::mutex> lock = lockTimed(shard.mutex, lock_wait);
+    auto it = shard.entries.find(id);
+    if (it == shard.entries.end() || !pred(it->second)) return false;
+    shard.entries.erase(it);
+    return true;
+  }
+
+  Stats stats() const { return {edits_issued.load(), edits_suppressed.load()}; }
+
+  std::atomic<uint64_t> edits_issued{0};
+  std::atomic<uint64_t> edits_suppressed{0};
+
+  StarboardStore store;
+
+private:
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<dpp::snowflake, StarboardEntry> entries;
+  };
+
+  void restore(dpp::snowflake id, StarboardEntry &entry) {
+    const std::optional<StarboardStore::Record> record = store.get(id);
+    if (!record) return;
+    entry.post.id = record->post_id;
+    entry.post.channel_id = record->post_channel_id;
+    entry.stars = record->stars;
+    entry.counted = true; // The url is still empty, so the next update fetches the message again
+  }
+
+  Shard &shard_for(dpp::snowflake id) {
+    // The low bits of a snowflake are a per-process increment, mix in the timestamp bits too
+    const uint64_t value = static_cast<uint64_t>(id);
+    return shards[(value ^ (value >> 22)) % shards.size()];
+  }
+
+  std::array<Shard, 32> shards;
+  Histogram &lock_wait = Metrics::instance().histogram("bot_mutex_wait_seconds", "Time spent waiting for a lock",
+                                                       {{"mutex", "starboard_shard"}});
+};
@@ -0,0 +1,162 @@
+#include "starboard_store.hpp"
+#include "file_io.hpp"
+#include "logger.hpp"
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+uint32_t checksum(const StarboardStore::Record &record) {
+  // FNV-1a over everything before the checksum field
+  uint32_t hash = 2166136261u;
+  const auto *bytes = reinterpret_cast<const unsigned char *>(&record);
+  for (size_t i = 0; i < offsetof(StarboardStore::Record, checksum); i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+} // namespace
+
+StarboardStore::StarboardStore(std::string path) : path(std::move(path)) {
+  load();
+  fd = open(this->path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    LOG_ERROR("Failed to open " << this->path << ", starboard posts won't survive a restart");
+  }
+}
+
+StarboardStore::~StarboardStore() {
+  sync();
+  if (fd >= 0) close(fd);
+}
+
+void StarboardStore::load() {
+  const int in = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in < 0) return;
+
+  struct stat st;
+  if (fstat(in, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Record))) {
+    close(in);
+    return;
+  }
+
+  // Map the file and replay it, later records win
+  const size_t length = static_cast<size_t>(st.st_size);
+  void *map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, in, 0);
+  close(in);
+  if (map == MAP_FAILED) return;
+
+  const size_t count = length / sizeof(Record);
+  records.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    Record record;
+    std::memcpy(&record, static_cast<const char *>(map) + i * sizeof(Record), sizeof(Record));
+    if (record.checksum != checksum(record)) break; // Torn write, everything after it is garbage
+    if (record.post_id == 0) {
+      records.erase(record.source_id);
+    } else {
+      records[record.source_id] = record;
+    }
+    file_records++;
+  }
+  munmap(map, length);
+
+  // Drop a partial tail so new appends start on a record boundary
+  if (file_records * sizeof(Record) != length && truncate(path.c_str(), static_cast<off_t>(file_records * sizeof(Record))) != 0) {
+    LOG_ERROR("Failed to truncate damaged tail of " << path);
+  }
+}
+
+std::optional<StarboardStore::Record> StarboardStore::get(uint64_t source_id) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = records.find(source_id);
+  if (it == records.end()) return std::nullopt;
+  return it->second;
+}
+
+void StarboardStore::put(uint64_t source_id, uint64_t post_id, uint64_t post_channel_id, int32_t stars) {
+  Record record{source_id, post_id, post_channel_id, stars, 0};
+  record.checksum = checksum(record);
+  std::lock_guard<std::mutex> lock(mutex);
+  records[source_id] = record;
+  append(record);
+}
+
+void StarboardStore::erase(uint64_t source_id) {
+  Record record{source_id, 0, 0, 0, 0};
+  record.checksum = checksum(record);
+  std::lock_guard<std::mutex> lock(mutex);
+  if (records.erase(source_id) == 0) return;
+  append(record);
+}
+
+void StarboardStore::append(const Record &record) {
+  if (fd < 0) return;
+  if (!writeAll(fd, &record, sizeof(record))) {
+    // Cut a partial record off again, later appends would be misaligned and dropped at the next load
+    LOG_ERROR("Failed to append to " << path);
+    if (ftruncate(fd, static_cast<off_t>(file_records * sizeof(Record))) != 0) {
+      LOG_ERROR("Failed to truncate " << path << " back to its last record");
+    }
+    return;
+  }
+  file_records++;
+  unsynced = true;
+}
+
+void StarboardStore::sync() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (fd < 0 || !unsynced) return;
+  if (fdatasync(fd) != 0) {
+    LOG_ERROR("Failed to sync " << path);
+    return;
+  }
+  unsynced = false;
+}
+
+void StarboardStore::compact() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (file_records < 1024 || file_records < records.size() * 2) return;
+  rewrite();
+}
+
+size_t StarboardStore::size() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return records.size();
+}
+
+void StarboardStore::rewrite() {
+  std::vector<Record> live;
+  live.reserve(records.size());
+  for (const auto &[id, record] : records) {
+    live.push_back(record);
+  }
+
+  // Write the live records next to the file and swap it in atomically
+  const std::string tmp = path + ".tmp";
+  const int out = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (out < 0) return;
+  const bool ok = writeAll(out, live.data(), live.size() * sizeof(Record)) && fsync(out) == 0;
+  close(out);
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+    LOG_ERROR("Failed to compact " << path);
+    unlink(tmp.c_str());
+    return;
+  }
+
+  // Make the rename itself durable, or a crash could bring back the old file
+  if (!syncParentDirectory(path)) {
+    LOG_ERROR("Failed to sync directory of " << path);
+  }
+
+  if (fd >= 0) close(fd);
+  fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+  file_records = live.size();
+  unsynced = false;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// Append-only file mapping starred messages to their starboard posts, survives restarts
+class StarboardStore {
+public:
+  struct Record {
+    uint64_t source_id;
+    uint64_t post_id; // 0 marks a removed post
+    uint64_t post_channel_id;
+    int32_t stars;
+    uint32_t checksum; // Detects a torn record at the end of the file after a crash
+  };
+
+  explicit StarboardStore(std::string path = "../starboard.db");
+  ~StarboardStore();
+
+  StarboardStore(const StarboardStore &) = delete;
+  StarboardStore &operator=(const StarboardStore &) = delete;
+
+  std::optional<Record> get(uint64_t source_id);
+  void put(uint64_t source_id, uint64_t post_id, uint64_t post_channel_id, int32_t stars);
+  void erase(uint64_t source_id);
+
+  // Rewrite the file with only live records once dead ones dominate it
+  void compact();
+
+  // Flush appends to disk, called periodically so a crash loses at most the last few seconds of records
+  void sync();
+
+  size_t size();
+
+private:
+  void load();
+  void append(const Record &record); // Caller holds mutex
+  void rewrite();                    // Caller holds mutex
+
+  const std::string path;
+  std::mutex mutex;
+  std::unordered_map<uint64_t, Record> records;
+  size_t file_records = 0; // Records in the file, including overwritten ones and tombstones
+  int fd = -1;
+  bool unsynced = false; // Appended since the last sync
+};
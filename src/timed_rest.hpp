@@ -0,0 +1,30 @@
+#pragma once
+
+#include "metrics.hpp"
+#include <chrono>
+#include <dpp/dpp.h>
+#include <string>
+#include <type_traits>
+
+// Await a REST call, recording its latency and HTTP status under `route`
+template <typename T> dpp::task<T> timedRest(std::string route, dpp::async<T> call) {
+  const auto start = std::chrono::steady_clock::now();
+  T result = co_await std::move(call);
+  if constexpr (std::is_same_v<T, dpp::http_request_completion_t>) {
+    Metrics::instance().record_rest(route, result.status, std::chrono::steady_clock::now() - start);
+  } else {
+    Metrics::instance().record_rest(route, result.http_info.status, std::chrono::steady_clock::now() - start);
+  }
+  co_return result;
+}
+
+// Completion callback for a REST call made now, records it under `route` and then calls `next`
+// `next` defaults to the callback DPP would have used, which logs errors
+inline dpp::command_completion_event_t timedCallback(std::string route,
+                                                     dpp::command_completion_event_t next = dpp::utility::log_error()) {
+  return [route = std::move(route), next = std::move(next),
+          start = std::chrono::steady_clock::now()](const dpp::confirmation_callback_t &result) {
+    Metrics::instance().record_rest(route, result.http_info.status, std::chrono::steady_clock::now() - start);
+    if (next) next(result);
+  };
+}